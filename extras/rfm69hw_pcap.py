@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2014-2016 Jacob McGladdery
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+"""Convert the records written by RFM69HW::sniff() into pcapng.
+
+Reads from a serial port, a file or standard input, and writes pcapng to a
+file or standard output. Each frame is stored as it was on air, starting with
+its length byte. The RSSI, frequency offset and CRC status go into the packet
+comment, a CRC failure is also flagged as such, and frames the sniffer had to
+drop are counted against the following packet.
+
+Capture live into Wireshark:
+
+    rfm69hw_pcap.py -b 2000000 /dev/ttyACM0 - | wireshark -k -i -
+"""
+
+import argparse
+import os
+import stat
+import struct
+import sys
+import termios
+import time
+
+SYNC = 0xA5
+HEADER = struct.Struct('<IbhBB')
+MAX_FRAME = 65
+
+# Size of one synthesizer step in Hz, 32 MHz / 2^19
+FSTEP_HZ = 32e6 / (1 << 19)
+
+# No link type is assigned to the RFM69 packet format
+LINKTYPE_USER0 = 147
+
+# Link-layer error bit of the enhanced packet block flags for a bad CRC
+EPB_FLAG_CRC_ERROR = 1 << 24
+
+
+def option(code, value):
+    padding = -len(value) % 4
+    return struct.pack('<HH', code, len(value)) + value + b'\0' * padding
+
+
+def block(kind, body):
+    length = 12 + len(body)
+    return struct.pack('<II', kind, length) + body + struct.pack('<I', length)
+
+
+def section_header():
+    return block(0x0A0D0D0A, struct.pack('<IHHq', 0x1A2B3C4D, 1, 0, -1))
+
+
+def interface(linktype):
+    # Timestamps are in microseconds, the resolution of the sniffer
+    options = option(9, b'\x06') + option(0, b'')
+    return block(1, struct.pack('<HHI', linktype, 0, 255) + options)
+
+
+def packet(timestamp, frame, rssi, offset, crc_ok, dropped):
+    comment = 'rssi=%d dBm offset=%+d Hz crc=%s' % (
+        rssi, round(offset * FSTEP_HZ), 'ok' if crc_ok else 'bad')
+    options = option(1, comment.encode())
+    if not crc_ok:
+        options += option(2, struct.pack('<I', EPB_FLAG_CRC_ERROR))
+    if dropped:
+        options += option(4, struct.pack('<Q', dropped))
+    options += option(0, b'')
+
+    padding = -len(frame) % 4
+    body = struct.pack('<IIIII', 0, timestamp >> 32, timestamp & 0xFFFFFFFF,
+                       len(frame), len(frame))
+    return block(6, body + frame + b'\0' * padding + options)
+
+
+def records(source):
+    """Yield (time, frame, rssi, offset, crc_ok, dropped) for each record.
+
+    Bytes which do not start a record with a valid length and check byte are
+    skipped, which also finds the first record when joining part way through.
+    """
+    buffer = bytearray()
+    while True:
+        chunk = source.read1(4096) if hasattr(source, 'read1') else source.read(4096)
+        if not chunk:
+            return
+        buffer += chunk
+
+        while True:
+            start = buffer.find(bytes([SYNC]))
+            if start < 0:
+                del buffer[:]
+                break
+            del buffer[:start]
+
+            if len(buffer) < 2:
+                break
+            size = buffer[1]
+            if size > MAX_FRAME:
+                del buffer[:1]
+                continue
+
+            end = 1 + 1 + HEADER.size + size + 1
+            if len(buffer) < end:
+                break
+
+            check = 0
+            for value in buffer[1:end]:
+                check ^= value
+            if check != 0:
+                del buffer[:1]
+                continue
+
+            when, rssi, offset, crc_ok, dropped = HEADER.unpack_from(buffer, 2)
+            frame = bytes(buffer[1:2]) + bytes(buffer[2 + HEADER.size:end - 1])
+            del buffer[:end]
+            yield when, frame, rssi, offset, bool(crc_ok), dropped
+
+
+def configure(fd, baud):
+    # Raw mode at the requested baud rate, as used by the sketch
+    speed = getattr(termios, 'B%d' % baud, None)
+    if speed is None:
+        sys.exit('unsupported baud rate: %d' % baud)
+
+    attributes = termios.tcgetattr(fd)
+    attributes[0] = 0
+    attributes[1] = 0
+    attributes[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attributes[3] = 0
+    attributes[4] = speed
+    attributes[5] = speed
+    attributes[6][termios.VMIN] = 1
+    attributes[6][termios.VTIME] = 0
+    termios.tcsetattr(fd, termios.TCSANOW, attributes)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='serial port or file to read, - for standard input')
+    parser.add_argument('output', help='pcapng file to write, - for standard output')
+    parser.add_argument('-b', '--baud', type=int, default=2000000,
+                        help='baud rate when reading a serial port (default: %(default)s)')
+    parser.add_argument('-l', '--linktype', type=int, default=LINKTYPE_USER0,
+                        help='pcap link type of the frames (default: %(default)s, USER0)')
+    args = parser.parse_args()
+
+    if args.input == '-':
+        source = sys.stdin.buffer
+    else:
+        source = open(args.input, 'rb', buffering=0)
+        if stat.S_ISCHR(os.fstat(source.fileno()).st_mode):
+            configure(source.fileno(), args.baud)
+
+    sink = sys.stdout.buffer if args.output == '-' else open(args.output, 'wb')
+    sink.write(section_header() + interface(args.linktype))
+    sink.flush()
+
+    # The sniffer timestamps with a free running 32-bit microsecond counter.
+    # It is unwrapped, and lined up with the wall clock at the first record.
+    base = None
+    last = 0
+    wraps = 0
+    try:
+        for when, frame, rssi, offset, crc_ok, dropped in records(source):
+            if base is None:
+                base = int(time.time() * 1e6) - when
+            elif when < last:
+                wraps += 1
+            last = when
+
+            timestamp = base + (wraps << 32) + when
+            sink.write(packet(timestamp, frame, rssi, offset, crc_ok, dropped))
+            sink.flush()
+    except (KeyboardInterrupt, BrokenPipeError):
+        pass
+
+
+if __name__ == '__main__':
+    main()
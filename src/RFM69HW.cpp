@@ -23,8 +23,8 @@ THE SOFTWARE.
 */
 
 #include "RFM69HW.h"
+#include "RFM69HWGroup.h"
 
-#include <SPI.h>
 #include "RFM69HW_registers.h"
 
 // Utilities
@@ -32,82 +32,372 @@ THE SOFTWARE.
 
 // Device info
 #define VERSION  (0x24)
+#define FIFO_SIZE  (66)
+
+// Streaming transmit. The FIFO is topped up whenever it drains to the
+// threshold level, which leaves room for the refill chunk.
+#define FIFO_THRESHOLD  (FIFO_SIZE / 2)
+#define FIFO_REFILL  (FIFO_SIZE - FIFO_THRESHOLD - 1)
+
+// Packet pool and receive queue
+#define POOL_MASK  (RFM69HW_PACKET_POOL_SIZE - 1)
+
+static_assert(RFM69HW_PACKET_POOL_SIZE <= 128 &&
+              (RFM69HW_PACKET_POOL_SIZE & POOL_MASK) == 0,
+              "RFM69HW_PACKET_POOL_SIZE must be a power of two no larger than 128");
+
+// Transmit queue
+#define TX_QUEUE_MASK  (RFM69HW_TX_QUEUE_LENGTH - 1)
+
+static_assert(RFM69HW_TX_QUEUE_LENGTH <= 128 &&
+              (RFM69HW_TX_QUEUE_LENGTH & TX_QUEUE_MASK) == 0,
+              "RFM69HW_TX_QUEUE_LENGTH must be a power of two no larger than 128");
+
+// Listen mode timer resolutions
+#define LISTEN_RESOL_64US  (64)
+#define LISTEN_RESOL_4_1MS  (4100)
+#define LISTEN_RESOL_262MS  (262000)
+
+// Timeouts for waiting on the device, in microseconds
+#define WAIT_POLL_US  (10)
+#define MODE_READY_TIMEOUT_US  (10000)
+#define HOP_TIMEOUT_US  (10000)
+#define RSSI_TIMEOUT_US  (10000)
+#define TEMPERATURE_TIMEOUT_US  (1000)
+#define CALIBRATION_TIMEOUT_US  (2000)
+#define TX_MARGIN_US  (10000)
+
+// Bytes sent on air around every payload: preamble, sync word, length,
+// address and CRC
+#define PACKET_OVERHEAD  (20)
+
+// Drift tracking. Temperature bands are 16 C wide, starting at -40 C. The
+// offset of a peer is smoothed over the last few packets.
+#define DRIFT_BAND_MIN_C  (-40)
+#define DRIFT_BAND_WIDTH_C  (16)
+#define DRIFT_SMOOTHING  (4)
+
+// AutoModes setting which keys up on the first byte loaded into the FIFO and
+// drops back to the main mode once the packet is sent
+#define AUTO_TRANSMIT  (RFM69HW_AUTOMODES_ENTER_FIFO_NOT_EMPTY | \
+                        RFM69HW_AUTOMODES_EXIT_PACKET_SENT | \
+                        RFM69HW_AUTOMODES_INTERMEDIATE_TX)
+
+// Default listen before talk threshold, the same as the power-on value of the
+// receiver's own RSSI threshold
+#define LBT_THRESHOLD_DBM  (-114)
+
+// Multiplier of the channel hopping sequence. Any value which is one more
+// than a multiple of four gives a full cycle.
+#define HOP_MULTIPLIER  (109)
+
+// Default time a partly filled Stream frame waits for more bytes
+#define FLUSH_TIMEOUT_MS  (10)
+
+// Register shadow
+#define SHADOW_FIRST  (RFM69HW_OPMODE)
+#define SHADOW_LAST  (RFM69HW_TEMP2)
 
 // Clocks
 #define FXOSC_HZ  (32 * MILLION)
-#define FSTEP_HZ  (61)
-#define SPI_SPEED_HZ  (10 * MILLION)
+
+// Bit rate the device comes out of reset with, in bits per second
+#define RESET_BITRATE  (4800)
+
+// The frequency synthesizer step is FXOSC / 2^19, which is exactly
+// 15625 / 256 Hz
+#define FSTEP_NUM  (15625UL)
+#define FSTEP_DEN  (256UL)
+
+#if RFM69HW_INSTRUMENTATION
+// Profile which SPI traffic is currently charged to
+static RFM69HW::Profile* activeProfile = NULL;
+
+// Charges all SPI traffic within its scope to a profile. Only the outermost
+// public call is charged, unless the scope is for the interrupt handler.
+class ProfileScope {
+public:
+    ProfileScope(RFM69HW::Profile& profile, const bool preempt) :
+        previous(activeProfile)
+    {
+        if (preempt || !activeProfile) {
+            activeProfile = &profile;
+            ++profile.calls;
+        }
+    }
+
+    ~ProfileScope() {
+        activeProfile = previous;
+    }
+
+private:
+    RFM69HW::Profile* const previous;
+};
+
+#define PROFILE(id)  volatile ProfileScope profileScope(profiles[RFM69HW::id], false)
+#define PROFILE_INTERRUPT()  volatile ProfileScope profileScope(profiles[RFM69HW::ProfileInterrupt], true)
+#else
+#define PROFILE(id)
+#define PROFILE_INTERRUPT()
+#endif
 
 class SPIGuard {
 public:
-    SPIGuard(const uint8_t slaveSelectPin) :
+    SPIGuard(RFM69HWHal& hal, const int8_t slaveSelectPin) :
+        hal(hal),
         slaveSelectPin(slaveSelectPin)
     {
-        SPI.beginTransaction(SPISettings(SPI_SPEED_HZ, MSBFIRST, SPI_MODE0));
-        digitalWrite(slaveSelectPin, LOW);
+#if RFM69HW_INSTRUMENTATION
+        start = hal.micros();
+#endif
+        hal.spiSelect(slaveSelectPin);
     }
 
     ~SPIGuard() {
-        digitalWrite(slaveSelectPin, HIGH);
-        SPI.endTransaction();
+        hal.spiDeselect(slaveSelectPin);
+#if RFM69HW_INSTRUMENTATION
+        if (activeProfile) {
+            ++activeProfile->transactions;
+            activeProfile->busMicros += hal.micros() - start;
+        }
+#endif
+    }
+
+    uint8_t transfer(const uint8_t value) volatile {
+        count(1);
+        return hal.spiTransfer(value);
+    }
+
+    void send(const uint8_t* buffer, const size_t size) volatile {
+        count(size);
+        hal.spiSend(buffer, size);
+    }
+
+    void receive(uint8_t* buffer, const size_t size) volatile {
+        count(size);
+        hal.spiReceive(buffer, size);
     }
 
 private:
-    const uint8_t slaveSelectPin;
+    void count(const size_t size) volatile {
+#if RFM69HW_INSTRUMENTATION
+        if (activeProfile)
+            activeProfile->bytes += size;
+#else
+        (void)size;
+#endif
+    }
+
+    RFM69HWHal& hal;
+    const int8_t slaveSelectPin;
+#if RFM69HW_INSTRUMENTATION
+    uint32_t start;
+#endif
 };
 
-RFM69HW::RFM69HW(const int8_t interruptPin, const int8_t slaveSelectPin, const int8_t resetPin) :
+#if RFM69HW_SHADOW_REGISTERS
+// Registers which the device changes by itself, or which cannot be read back,
+// always go to the device.
+static bool isShadowed(const uint8_t reg) {
+    if (reg < SHADOW_FIRST || reg > SHADOW_LAST)
+        return false;
+
+    if (reg >= RFM69HW_AESKEY1 && reg <= RFM69HW_AESKEY16)
+        return false;
+
+    switch (reg) {
+    case RFM69HW_OSC1:
+    case RFM69HW_AFCFEI:
+    case RFM69HW_AFCMSB:
+    case RFM69HW_AFCLSB:
+    case RFM69HW_FEIMSB:
+    case RFM69HW_FEILSB:
+    case RFM69HW_RSSICONFIG:
+    case RFM69HW_RSSIVALUE:
+    case RFM69HW_IRQFLAGS1:
+    case RFM69HW_IRQFLAGS2:
+    case RFM69HW_TEMP1:
+    case RFM69HW_TEMP2:
+        return false;
+    default:
+        return true;
+    }
+}
+
+static bool isShadowed(const uint8_t reg, const size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (!isShadowed(reg + i))
+            return false;
+    }
+
+    return true;
+}
+#endif
+
+static_assert(RFM69HW_MAX_RADIOS >= 1 && RFM69HW_MAX_RADIOS <= 4,
+              "RFM69HW_MAX_RADIOS must be between 1 and 4");
+
+RFM69HW* RFM69HW::instances[RFM69HW_MAX_RADIOS] = {};
+
+// Interrupt order across all radios. Zero marks no pending interrupt.
+static volatile uint8_t eventCount = 0;
+
+RFM69HW::RFM69HW(const int8_t interruptPin, const int8_t slaveSelectPin, const int8_t resetPin, RFM69HWHal& hal) :
     Stream(),
+    hal(hal),
     interruptPin(interruptPin),
     slaveSelectPin(slaveSelectPin),
-    resetPin(resetPin)
+    resetPin(resetPin),
+    group(NULL),
+    pendingEvent(0),
+    pendingTime(0),
+    listening(false),
+    opMode(RFM69HW_OPMODE_MODE_STANDBY),
+    addressing(false),
+    encrypting(false),
+    broadcastAddress(0xFF),
+    txPower(13),
+    highPower(false),
+    boosted(false),
+    bitrate(RESET_BITRATE),
+    continuous(false),
+    autoTransmit(false),
+    lbtTimeout(0),
+    lbtThreshold(-2 * LBT_THRESHOLD_DBM),
+    poolClaim(RFM69HW_NO_PACKET),
+    rxHead(0),
+    rxTail(0),
+    rxCurrent(RFM69HW_NO_PACKET),
+    rxOffset(0),
+    rxStreaming(false),
+    rxDropped(0),
+    sniffing(false),
+    sniffDropped(0),
+    carrierFrf(0),
+    tunedFrf(0),
+    driftTracking(false),
+    driftBand(0),
+    driftCount(0),
+    driftNext(0),
+    channels(NULL),
+    channelCount(0),
+    channelIndex(0),
+    hopMask(0),
+    hopIncrement(1),
+    txStaged(0),
+    txStageTime(0),
+    flushTimeout(FLUSH_TIMEOUT_MS),
+    txHead(0),
+    txTail(0),
+    txActive(false),
+    packetSent(false),
+    txReturnMode(RFM69HW_OPMODE_MODE_STANDBY),
+    txCallback(NULL)
 {
+    // Every buffer starts out free. Radios which are not globals do not get
+    // their memory cleared for them.
+    for (Handle handle = 0; handle < RFM69HW_PACKET_POOL_SIZE; ++handle)
+        poolUsed[handle] = false;
+
+#if RFM69HW_INSTRUMENTATION
+    resetProfiles();
+#endif
+}
+
+RFM69HW::~RFM69HW() {
+    // Give the interrupt slot back. The handler of an empty slot does nothing,
+    // so the interrupt can stay attached.
+    for (uint8_t slot = 0; slot < RFM69HW_MAX_RADIOS; ++slot) {
+        if (instances[slot] == this)
+            instances[slot] = NULL;
+    }
 }
 
 bool RFM69HW::begin() {
+    PROFILE(ProfileConfiguration);
+
     // Initialize SPI
-    SPI.begin();
+    hal.spiBegin();
 
     // Setup and deassert the slave select pin
-    pinMode(slaveSelectPin, OUTPUT);
-    digitalWrite(slaveSelectPin, HIGH);
+    hal.pinOutput(slaveSelectPin, true);
 
     // Setup and deassert the reset pin, if it was specified. Note that if the
     // reset pin was not left floating on the board, then the user must specify
     // the reset pin in order to ensure correct operation.
-    if (resetPin >= 0) {
-        pinMode(resetPin, OUTPUT);
-        digitalWrite(resetPin, LOW);
-    }
+    if (resetPin >= 0)
+        hal.pinOutput(resetPin, false);
 
     // The RFM69HW module performs an automatic power-on reset at power up.
     // Need to wait for 10 ms before commencing communication on SPI.
-    delay(10);
+    hal.delay(10);
+
+    // Load the register shadow with the power-on values
+    resync();
 
     // Sanity check to make sure we're really communicating with a RFM69HW
     if (version() != VERSION)
         return false;
 
+    carrierFrf = tunedFrf;
+
     // Disable the CLKOUT signal. It shouldn't be needed for anything and
     // disabling it reduces current consumption.
     write8(RFM69HW_DIOMAPPING2, RFM69HW_DIOMAPPING2_CLKOUT_OFF);
 
     // Set the TX start condition to be whenever data has been written into the
     // FIFO. This will cause the transmit function to transmit data immediatly.
-    write8(RFM69HW_FIFOTHRESH, RFM69HW_FIFOTHRESH_TX_START_FIFO_NOT_EMPTY);
+    // The FIFO level threshold is used to refill the FIFO when streaming
+    // payloads which are larger than it.
+    write8(RFM69HW_FIFOTHRESH, RFM69HW_FIFOTHRESH_TX_START_FIFO_NOT_EMPTY |
+                               (FIFO_THRESHOLD & RFM69HW_FIFOTHRESH_FIFO_THRESHOLD_MASK));
+
+    // Use variable length packets so that every payload carries its own
+    // length byte. The payload length register then sets the largest packet
+    // the receiver will accept, which is whatever fits in the FIFO. Packets
+    // which fail the CRC check are dropped by the device.
+    write8(RFM69HW_PACKETCONFIG1,
+           RFM69HW_PACKETCONFIG1_FORMAT_VARIABLE | RFM69HW_PACKETCONFIG1_CRC_ON);
+    write8(RFM69HW_PAYLOADLENGTH, RFM69HW_MAX_PAYLOAD);
+
+    // The device powers up transmitting on PA0, which the HW module does not
+    // connect to the antenna
+    setTransmitPower(txPower);
+
+    // Map DIO0 to PayloadReady while in RX and hook it up to the interrupt
+    // handler. Registering the interrupt with the SPI library keeps the
+    // handler from running in the middle of one of our own SPI transactions.
+    write8(RFM69HW_DIOMAPPING1, RFM69HW_DIOMAPPING1_DIO0_01);
+
+    // One interrupt handler per radio slot, as attachInterrupt() passes
+    // nothing to the handler which could tell the radios apart
+    static void (* const isrs[4])() = { isr<0>, isr<1>, isr<2>, isr<3> };
+
+    // Claim a slot for the interrupt handler. A radio which is started again
+    // keeps the slot it already has.
+    uint8_t slot = 0;
+    while (slot < RFM69HW_MAX_RADIOS && instances[slot] && instances[slot] != this)
+        ++slot;
+    if (slot == RFM69HW_MAX_RADIOS)
+        return false;
+
+    instances[slot] = this;
+    hal.pinInput(interruptPin);
+    hal.spiUsingInterrupt(interruptPin);
+    hal.attachInterrupt(interruptPin, isrs[slot]);
 
     return true;
 }
 
 bool RFM69HW::begin(const uint32_t baudRate, const uint32_t frequency) {
+    PROFILE(ProfileConfiguration);
+
     if (!begin())
         return false;
 
     // Set the frequency and baud rate to use
     setBaudRate(baudRate);
-    setCarrierFrequencyMHz(frequency);
-
-    return true;
+    return setCarrierFrequencyMHz(frequency);
 }
 
 void RFM69HW::reset() {
@@ -118,29 +408,51 @@ void RFM69HW::reset() {
     //   1) Pull the reset pin high for 100 us
     //   2) Pull the reset pin back to low
     //   3) Wait for 5 ms before using the device again
-    digitalWrite(resetPin, HIGH);
-    delayMicroseconds(100);
-    digitalWrite(resetPin, LOW);
-    delay(5);
+    hal.pinWrite(resetPin, true);
+    hal.delayMicroseconds(100);
+    hal.pinWrite(resetPin, false);
+    hal.delay(5);
+
+    // Every register is back to its reset value
+    bitrate = RESET_BITRATE;
+    resync();
 }
 
 int RFM69HW::available() {
-    // TODO
-    return 0;
+    // Sketches poll available() from their main loop, which makes it the place
+    // to move the transmit queue along and to send out a frame which has
+    // stopped growing
+    serviceTransmit();
+    flushIfIdle();
+
+    // Move on to the next packet once the current one has been read
+    while (rxCurrent == RFM69HW_NO_PACKET || rxOffset == pool[rxCurrent].size) {
+        if (!nextReceived())
+            return 0;
+    }
+
+    return pool[rxCurrent].size - rxOffset;
 }
 
 int RFM69HW::peek() {
-    // TODO
-    return 0;
+    if (!available())
+        return -1;
+
+    return pool[rxCurrent].data[rxOffset];
 }
 
 void RFM69HW::flush() {
-    // TODO
+    // Send whatever has been written so far, then wait for it and anything
+    // queued by sendAsync() to go out
+    sendStaged();
+    waitIdle();
 }
 
 int RFM69HW::read() {
-    // TODO
-    return 0;
+    if (!available())
+        return -1;
+
+    return pool[rxCurrent].data[rxOffset++];
 }
 
 size_t RFM69HW::write(uint8_t value) {
@@ -149,190 +461,1728 @@ size_t RFM69HW::write(uint8_t value) {
 }
 
 size_t RFM69HW::write(const uint8_t* buffer, size_t size) {
+    // Bytes which have been waiting too long go out on their own first
+    flushIfIdle();
+
+    // Collect the bytes into frames of the largest payload which fits in the
+    // FIFO, sending each one as it fills. Bytes stay staged when a frame could
+    // not be sent, so they are only counted as accepted once they are in the
+    // staging buffer.
+    const uint8_t frame = maxPayload();
+    size_t accepted = 0;
+    while (accepted < size) {
+        // Whole frames go straight out without being copied into the staging
+        // buffer
+        if (txStaged == 0 && size - accepted >= frame) {
+            if (!transmit(broadcastAddress, &buffer[accepted], frame))
+                break;
+            accepted += frame;
+            continue;
+        }
+
+        const size_t space = txStaged < frame ? frame - txStaged : 0;
+        const size_t count = (size - accepted) < space ? (size - accepted) : space;
+        memcpy(&txStage[txStaged], &buffer[accepted], count);
+        txStaged += count;
+        accepted += count;
+
+        if (txStaged >= frame && !sendStaged())
+            break;
+    }
+
+    txStageTime = hal.millis();
+    return accepted;
+}
+
+void RFM69HW::setFlushTimeout(const uint32_t timeout) {
+    flushTimeout = timeout;
+}
+
+size_t RFM69HW::transmit(const uint8_t address, const uint8_t* buffer, size_t size) {
+    PROFILE(ProfileWrite);
+
+    // Encrypted packets have to fit in the FIFO in one go
+    if (encrypting && size > maxPayload())
+        size = maxPayload();
+
+    // Payloads with more bytes than the length byte can express are sent in
+    // unlimited length packet mode. There is no length byte, address or CRC
+    // in this mode, so the receiving end has to know how much data to expect.
+    // Anything longer than RFM69HW_MAX_PAYLOAD has to be picked up with
+    // receiveStream() on the other end.
+    const bool unlimited = size + addressing > UINT8_MAX;
+
+    // There is no packet engine in the continuous modes. Let any queued
+    // asynchronous transmissions finish first.
+    if (continuous || !waitIdle())
+        return 0;
+
+    // Remember if the receiver was running so it can be restarted afterwards
+    const uint8_t mode = currentMode();
+
+    // Hold off until nobody else is transmitting on the channel
+    if (lbtTimeout && !waitChannelClear()) {
+        restoreMode(mode);
+        return 0;
+    }
+
     // Change the op mode to standby. This will prevent the radio from
     // receiving anything and therefore overwriting the FIFO while we are still
     // sending the current payload out.
-    standby();
+    if (!standby())
+        return 0;
+
+    // Aim the transmitter at where the peer's receiver actually is
+    const uint32_t tuned = tunedFrf;
+    bool retuned = false;
+    if (driftTracking) {
+        const uint32_t corrected = carrierFrf + driftOffset(address);
+        retuned = corrected != tuned;
+        if (retuned)
+            write24(RFM69HW_FRFMSB, tunedFrf = corrected);
+    }
+
+    // Unlimited length packet mode is selected using the fixed length format
+    // with a payload length of zero. PacketSent never comes in this mode, so
+    // AutoModes could not bring the radio out of TX and is left disarmed.
+    const uint8_t packetConfig = read8(RFM69HW_PACKETCONFIG1);
+    const uint8_t payloadLength = read8(RFM69HW_PAYLOADLENGTH);
+    if (unlimited) {
+        write8(RFM69HW_PACKETCONFIG1, packetConfig & ~RFM69HW_PACKETCONFIG1_FORMAT_VARIABLE);
+        write8(RFM69HW_PAYLOADLENGTH, 0);
+    }
+    armAutoTransmit(!unlimited);
+
+    // Map DIO0 to PacketSent while in TX, so the end of the transmission is
+    // signalled by the interrupt handler rather than by polling the device.
+    // This, and the PA boost, are done before the FIFO is loaded as AutoModes
+    // may key up on the first byte.
+    if (autoTransmit && !unlimited)
+        setBoost(true);
+    packetSent = false;
+    write8(RFM69HW_DIOMAPPING1, RFM69HW_DIOMAPPING1_DIO0_00);
 
-    // Write the payload to the device FIFO. Do this in its own scope so the
-    // lifetime of the SPIGuard object is guaranteed.
+    // Fill the FIFO with the length byte and as much of the payload as fits.
+    // Do this in its own scope so the lifetime of the SPIGuard object is
+    // guaranteed.
+    size_t sent = 0;
     {
-        volatile SPIGuard guard(slaveSelectPin);
-        SPI.transfer(RFM69HW_FIFO | 0x80);
-        for (uint8_t i = 0; i < size; ++i)
-            SPI.transfer(buffer[i]);
+        volatile SPIGuard guard(hal, slaveSelectPin);
+        guard.transfer(RFM69HW_FIFO | 0x80);
+
+        uint8_t space = FIFO_SIZE;
+        if (!unlimited) {
+            guard.transfer(size + addressing);
+            --space;
+
+            if (addressing) {
+                guard.transfer(address);
+                --space;
+            }
+        }
+
+        sent = size < space ? size : space;
+        guard.send(buffer, sent);
     }
 
     // Change the op mode to TX. As long as the TX start condition has been set
-    // to FIFO not empty, then the transmission will occur immediatly.
-    setOpMode(RFM69HW_OPMODE_MODE_TX);
+    // to FIFO not empty, then the transmission will occur immediatly. With
+    // AutoModes the device is already on its way into TX.
+    bool ok = (autoTransmit && !unlimited) || setOpMode(RFM69HW_OPMODE_MODE_TX);
+
+    // Stream the rest of the payload in, topping up the FIFO each time it
+    // drains down to the threshold level
+    const uint32_t refillTimeout = 2 * FIFO_SIZE * byteTime() + TX_MARGIN_US;
+    while (ok && sent < size) {
+        ok = waitFor(WaitFifoLevel, RFM69HW_IRQFLAGS2, RFM69HW_IRQFLAGS2_FIFO_LEVEL, false, refillTimeout);
+        if (!ok)
+            break;
+
+        const size_t count = (size - sent) < FIFO_REFILL ? (size - sent) : FIFO_REFILL;
+        writeBurst(RFM69HW_FIFO, &buffer[sent], count);
+        sent += count;
+    }
+
+    if (unlimited) {
+        // PacketSent is never raised in unlimited length packet mode. Wait for
+        // the FIFO to empty, then for the last byte to leave the shift
+        // register, and restore the packet format.
+        ok = ok && waitFor(WaitFifoLevel, RFM69HW_IRQFLAGS2, RFM69HW_IRQFLAGS2_FIFO_NOT_EMPTY, false, refillTimeout);
+        if (ok)
+            hal.delayMicroseconds(byteTime());
+        standby();
+        write8(RFM69HW_PACKETCONFIG1, packetConfig);
+        write8(RFM69HW_PAYLOADLENGTH, payloadLength);
+    } else {
+        // Wait until the transmission has completed
+        ok = ok && waitForFlag(WaitPacketSent, packetSent, true, packetTimeout(size));
+    }
+
+    // Transmission complete. Put the radio back onto the frequency and into
+    // the mode it was in.
+    if (retuned)
+        write24(RFM69HW_FRFMSB, tunedFrf = tuned);
+    restoreMode(mode);
+
+    return ok ? size : 0;
+}
+
+bool RFM69HW::sendAsync(const uint8_t* buffer, size_t size) {
+    return enqueue(broadcastAddress, buffer, size);
+}
+
+size_t RFM69HW::sendTo(const uint8_t address, const uint8_t* buffer, size_t size) {
+    return transmit(address, buffer, size);
+}
+
+bool RFM69HW::sendToAsync(const uint8_t address, const uint8_t* buffer, size_t size) {
+    return enqueue(address, buffer, size);
+}
+
+uint32_t RFM69HW::receiveTime(const Handle handle) {
+    if (handle >= RFM69HW_PACKET_POOL_SIZE)
+        return 0;
+
+    return captures[handle].time;
+}
+
+bool RFM69HW::receive(Packet& packet) {
+    const Handle handle = borrow();
+    if (handle == RFM69HW_NO_PACKET)
+        return false;
+
+    packet.address = pool[handle].address;
+    packet.size = pool[handle].size;
+    memcpy(packet.data, pool[handle].data, packet.size);
+    release(handle);
+
+    return true;
+}
+
+size_t RFM69HW::receiveStream(uint8_t* buffer, const size_t size, const uint32_t timeout) {
+    PROFILE(ProfileOther);
+
+    // Receives one frame of up to 255 bytes, or an unlimited length frame of
+    // exactly the given size when that is more than the length byte can
+    // express. Frames longer than the buffer are cut short. The timeout, in
+    // milliseconds, is for the frame to start arriving.
+    if (continuous || size == 0 || !waitIdle())
+        return 0;
+
+    const uint8_t mode = currentMode();
+    const bool unlimited = size + addressing > UINT8_MAX;
+    const uint8_t packetConfig = read8(RFM69HW_PACKETCONFIG1);
+    const uint8_t payloadLength = read8(RFM69HW_PAYLOADLENGTH);
 
-    // Wait until the transmission has completed
-    while (~read8(RFM69HW_IRQFLAGS2) & RFM69HW_IRQFLAGS2_PACKET_SENT);
+    // Take the FIFO over from the interrupt handler and let the receiver
+    // accept every frame transmit() can send. Writing the overrun flag clears
+    // whatever is left in the FIFO. Unlimited length frames carry no address
+    // byte, so the address filter would check the first byte of the payload.
+    rxStreaming = true;
+    bool ok = standby();
+    write8(RFM69HW_IRQFLAGS2, RFM69HW_IRQFLAGS2_FIFO_OVERRUN);
+    if (unlimited) {
+        write8(RFM69HW_PACKETCONFIG1, packetConfig & ~(RFM69HW_PACKETCONFIG1_FORMAT_VARIABLE |
+                                                       RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK));
+        write8(RFM69HW_PAYLOADLENGTH, 0);
+    } else {
+        write8(RFM69HW_PAYLOADLENGTH, UINT8_MAX);
+    }
+
+    ok = ok && setOpMode(RFM69HW_OPMODE_MODE_RX) &&
+         waitFor(WaitFifoLevel, RFM69HW_IRQFLAGS2, RFM69HW_IRQFLAGS2_FIFO_NOT_EMPTY, true, timeout * 1000);
+
+    size_t received = 0;
+    if (ok && unlimited) {
+        // There is no length byte, and nothing marks the end of the frame
+        ok = drainFifo(buffer, size);
+        received = size;
+    } else if (ok) {
+        uint8_t length = 0;
+        ok = drainFifo(&length, 1);
+        if (ok && addressing && length > 0) {
+            uint8_t address;
+            ok = drainFifo(&address, 1);
+            --length;
+        }
+
+        // Hold the last byte back until the packet engine has checked the
+        // CRC. A frame which fails it is cleared from the FIFO, and
+        // PayloadReady never comes.
+        if (ok && length > 0) {
+            const size_t kept = length < size ? length : size;
+            const size_t head = kept < (size_t)(length - 1) ? kept : length - 1;
+            ok = drainFifo(buffer, head) && drainFifo(NULL, length - 1 - head) &&
+                 waitFor(WaitFifoLevel, RFM69HW_IRQFLAGS2, RFM69HW_IRQFLAGS2_PAYLOAD_READY, true,
+                         2 * FIFO_SIZE * byteTime() + TX_MARGIN_US);
 
-    // Transmission complete. Change the op mode to standby.
+            uint8_t last;
+            ok = ok && drainFifo(&last, 1);
+            if (kept > head)
+                buffer[head] = last;
+            received = kept;
+        }
+    }
+
+    // Hand the FIFO back to the interrupt handler, without any leftovers of a
+    // frame which was cut off
     standby();
+    write8(RFM69HW_IRQFLAGS2, RFM69HW_IRQFLAGS2_FIFO_OVERRUN);
+    write8(RFM69HW_PACKETCONFIG1, packetConfig);
+    write8(RFM69HW_PAYLOADLENGTH, payloadLength);
+    rxStreaming = false;
+    restoreMode(mode);
 
-    return 0; // TODO: Return a real amount of bytes transmited
+    return ok ? received : 0;
 }
 
-void RFM69HW::standby() {
-    setOpMode(RFM69HW_OPMODE_MODE_STANDBY);
+RFM69HW::Handle RFM69HW::borrow() {
+    // Drops whatever is left of a packet which was partly read as a stream
+    if (!nextReceived())
+        return RFM69HW_NO_PACKET;
+
+    // The buffer now belongs to the caller until it is released or sent
+    const Handle handle = rxCurrent;
+    rxCurrent = RFM69HW_NO_PACKET;
+    return handle;
 }
 
-void RFM69HW::sleep() {
-    setOpMode(RFM69HW_OPMODE_MODE_SLEEP);
+RFM69HW::Handle RFM69HW::allocate() {
+    // Announce each buffer before checking it. The interrupt handler skips
+    // the announced buffer, so it cannot be claimed by both sides.
+    for (Handle handle = 0; handle < RFM69HW_PACKET_POOL_SIZE; ++handle) {
+        poolClaim = handle;
+        if (!poolUsed[handle]) {
+            poolUsed[handle] = true;
+            poolClaim = RFM69HW_NO_PACKET;
+            return handle;
+        }
+    }
+
+    poolClaim = RFM69HW_NO_PACKET;
+    return RFM69HW_NO_PACKET;
 }
 
-uint32_t RFM69HW::baudRate() {
-    return FXOSC_HZ / read16(RFM69HW_BITRATEMSB);
+RFM69HW::Packet& RFM69HW::packet(const Handle handle) {
+    // A handle from a failed borrow() or allocate() gets an empty packet of
+    // its own rather than reaching past the pool
+    if (handle >= RFM69HW_PACKET_POOL_SIZE) {
+        static Packet none;
+        none.size = 0;
+        return none;
+    }
+
+    return pool[handle];
 }
 
-void RFM69HW::setBaudRate(const uint32_t value) {
-    write16(RFM69HW_BITRATEMSB, FXOSC_HZ / value);
+void RFM69HW::release(const Handle handle) {
+    if (handle < RFM69HW_PACKET_POOL_SIZE)
+        poolUsed[handle] = false;
 }
 
-uint32_t RFM69HW::carrierFrequency() {
-    return FSTEP_HZ * read24(RFM69HW_FRFMSB);
+bool RFM69HW::sendAsync(const Handle handle) {
+    // The packet is sent to its own address. Its buffer is released once it
+    // has been loaded into the FIFO, so it has to be one the caller claimed.
+    if (handle >= RFM69HW_PACKET_POOL_SIZE || !poolUsed[handle] || pool[handle].size > maxPayload())
+        return false;
+
+    return enqueue(handle);
 }
 
-void RFM69HW::setCarrierFrequency(const uint32_t value) {
-    const uint32_t frf = value / FSTEP_HZ;
+bool RFM69HW::enqueue(const uint8_t address, const uint8_t* buffer, size_t size) {
+    PROFILE(ProfileSendAsync);
 
-    // Handle hopping under different op modes
-    switch (read8(RFM69HW_OPMODE) & RFM69HW_OPMODE_MODE_MASK) {
-    case RFM69HW_OPMODE_MODE_TX:
-        // Transmitter channel hop sequence:
-        //   1) Set the op mode to RX
-        //   2) Change the carrier frequency
-        //   3) Set the op mode back to TX
-        //   4) Wait for the TX start procedure to finish
-        setOpMode(RFM69HW_OPMODE_MODE_RX);
-        write24(RFM69HW_FRFMSB, frf);
-        setOpMode(RFM69HW_OPMODE_MODE_TX);
-        while (~read8(RFM69HW_IRQFLAGS1) & RFM69HW_IRQFLAGS1_TX_READY);
-        break;
-    case RFM69HW_OPMODE_MODE_RX:
-        // Receiver channel hop sequence:
-        //   1) Change the carrier frequency
-        //   2) Set the op mode to FS
-        //   3) Set the op mode back to RX
-        //   4) Wait for the RX start procedure to finish
-        write24(RFM69HW_FRFMSB, frf);
-        setOpMode(RFM69HW_OPMODE_MODE_FS);
-        setOpMode(RFM69HW_OPMODE_MODE_RX);
-        while (~read8(RFM69HW_IRQFLAGS1) & RFM69HW_IRQFLAGS1_RX_READY);
-        break;
-    default:
-        // Change the carrier frequency. It can take up to 80 us before the
-        // channel hop is completed
-        write24(RFM69HW_FRFMSB, frf);
-        delayMicroseconds(80);
-        break;
+    if (size > maxPayload())
+        return false;
+
+    // Queue is full
+    if ((uint8_t)(txHead - txTail) >= RFM69HW_TX_QUEUE_LENGTH)
+        return false;
+
+    const Handle handle = allocate();
+    if (handle == RFM69HW_NO_PACKET)
+        return false;
+
+    Packet& packet = pool[handle];
+    packet.address = address;
+    packet.size = size;
+    memcpy(packet.data, buffer, size);
+
+    if (!enqueue(handle)) {
+        release(handle);
+        return false;
     }
+
+    return true;
 }
 
-uint32_t RFM69HW::carrierFrequencyMHz() {
-    return carrierFrequency() / MILLION;
+bool RFM69HW::enqueue(const Handle handle) {
+    PROFILE(ProfileSendAsync);
+
+    // Queue is full, or there is no packet engine to send it with
+    if (continuous || (uint8_t)(txHead - txTail) >= RFM69HW_TX_QUEUE_LENGTH)
+        return false;
+
+    txQueue[txHead & TX_QUEUE_MASK] = handle;
+    txHead = txHead + 1;
+
+    // If nothing is on air then kick off the transmission. Otherwise the
+    // packet goes out once the current one is sent.
+    serviceTransmit();
+    if (!txActive) {
+        txActive = true;
+        txReturnMode = currentMode();
+
+        // Map DIO0 to PacketSent while in TX
+        write8(RFM69HW_DIOMAPPING1, RFM69HW_DIOMAPPING1_DIO0_00);
+        transmitNext();
+    }
+
+    return true;
 }
 
-void RFM69HW::setCarrierFrequencyMHz(const uint32_t value) {
-    setCarrierFrequency(value * MILLION);
+bool RFM69HW::transmitting() {
+    serviceTransmit();
+    return txActive;
 }
 
-int8_t RFM69HW::receivedSignalStrength() {
-    // Take the measurement
-    write8(RFM69HW_RSSICONFIG, RFM69HW_RSSICONFIG_RSSI_START);
-    while (~read8(RFM69HW_RSSICONFIG) & RFM69HW_RSSICONFIG_RSSI_DONE);
+void RFM69HW::onTransmit(Callback callback) {
+    txCallback = callback;
+}
 
-    // Convert the measured value to decibal-milliwatts. The equation used is:
-    // y = -x / 2. This equation comes from the RSSI value register
-    // documentation in the datasheet.
-    return -((int16_t)read8(RFM69HW_RSSIVALUE)) / 2;
+bool RFM69HW::standby() {
+    PROFILE(ProfileOpMode);
+
+    return setOpMode(RFM69HW_OPMODE_MODE_STANDBY);
 }
 
-uint8_t RFM69HW::version() {
-    return read8(RFM69HW_VERSION);
+bool RFM69HW::sleep() {
+    PROFILE(ProfileOpMode);
+
+    return setOpMode(RFM69HW_OPMODE_MODE_SLEEP);
 }
 
-int8_t RFM69HW::temperature() {
-    // This procedure can only be run in standby or FS op mode
-    standby();
+bool RFM69HW::receive() {
+    PROFILE(ProfileOpMode);
 
-    // Take the measurement. According to the datasheet, this should finish in
-    // less then 100 us.
-    write8(RFM69HW_TEMP1, RFM69HW_TEMP1_MEAS_START);
-    while (read8(RFM69HW_TEMP1) & RFM69HW_TEMP1_MEAS_RUNNING);
+    // Map DIO0 to PayloadReady while in RX. A transmission leaves it on
+    // PacketSent, which in RX is CrcOk and never fires for frames failing the
+    // CRC check. The continuous modes keep their own mapping.
+    if (!continuous)
+        write8(RFM69HW_DIOMAPPING1, RFM69HW_DIOMAPPING1_DIO0_01);
 
-    // Convert the measured value to degrees Celsius. The conversion involves
-    // taking the measurement and passing it through the equation:
-    // y = -x + 170. This equation does not come from the datasheet. It was
-    // found through testing where a value of 150 was found to be equal to a
-    // temperature of 20 C, and 140 was found to be equal to 30 C. The
-    // temperature sensor measures temperature using an ADC as -1 C per LSB, so
-    // the equation is obviously linear.
-    return -((int16_t)read8(RFM69HW_TEMP2)) + 170;
+    return setOpMode(RFM69HW_OPMODE_MODE_RX);
 }
 
-void RFM69HW::calibrateOscillator() {
-    // This procedure can only be run in standby mode
-    standby();
+// Pick the finest timer resolution which can still express the time. The
+// resolution is returned as its register field value.
+static uint8_t listenCoefficient(const uint32_t time, uint8_t& resolution) {
+    static const uint32_t resolutions[] = {
+        LISTEN_RESOL_64US,
+        LISTEN_RESOL_4_1MS,
+        LISTEN_RESOL_262MS,
+    };
 
-    // Trigger calibration and wait for it to finish. Unknown exactly how long
-    // this may take. Worst case time would be 500 us.
-    write8(RFM69HW_OSC1, RFM69HW_OSC1_RC_CAL_START);
-    while (~read8(RFM69HW_OSC1) & RFM69HW_OSC1_RC_CAL_DONE);
+    uint32_t coefficient = 0;
+    for (resolution = 1; resolution <= 3; ++resolution) {
+        coefficient = (time + resolutions[resolution - 1] - 1) / resolutions[resolution - 1];
+        if (coefficient <= UINT8_MAX)
+            break;
+    }
+
+    // Clamp to the range of the coefficient register
+    if (resolution > 3) {
+        resolution = 3;
+        return UINT8_MAX;
+    }
+
+    return coefficient ? coefficient : 1;
 }
 
-void RFM69HW::setOpMode(const uint8_t value) {
-    // Set the operating mode. Wait until the mode ready interrupt occurs
-    // before continuing.
-    write8(RFM69HW_OPMODE, value);
-    while (~read8(RFM69HW_IRQFLAGS1) & RFM69HW_IRQFLAGS1_MODE_READY);
+bool RFM69HW::listen(const uint32_t idleTime, const uint32_t rxTime, const ListenCriteria criteria) {
+    PROFILE(ProfileOpMode);
+
+    // Times are in microseconds. The device alternates between idle and RX
+    // on its own. After a packet it goes back to idle straight away, whether
+    // or not the FIFO has been read, and the FIFO is cleared when the next RX
+    // window starts. The interrupt handler drains it as soon as PayloadReady
+    // comes in.
+    uint8_t idleResolution;
+    uint8_t rxResolution;
+    uint8_t listen[3];
+    listen[1] = listenCoefficient(idleTime, idleResolution);
+    listen[2] = listenCoefficient(rxTime, rxResolution);
+    listen[0] = (idleResolution << 6) | (rxResolution << 4) |
+                (criteria == ListenRssiAndSync ? RFM69HW_LISTEN1_CRITERIA_SYNC : RFM69HW_LISTEN1_CRITERIA_RSSI) |
+                RFM69HW_LISTEN1_END_RESUME;
+
+    if (!standby())
+        return false;
+
+    writeBurst(RFM69HW_LISTEN1, listen, sizeof(listen));
+    return enterListen();
 }
 
-uint8_t RFM69HW::read8(const uint8_t reg) {
-    volatile SPIGuard guard(slaveSelectPin);
-    SPI.transfer(reg);
-    return SPI.transfer(0x00);
+size_t RFM69HW::sendBurst(const uint8_t* buffer, size_t size, const uint32_t duration) {
+    PROFILE(ProfileWrite);
+
+    if (size > maxPayload())
+        size = maxPayload();
+
+    // There is no packet engine in the continuous modes. Let any queued
+    // asynchronous transmissions finish first.
+    if (continuous || !waitIdle())
+        return 0;
+
+    const uint8_t mode = currentMode();
+    const uint32_t timeout = packetTimeout(size);
+    write8(RFM69HW_DIOMAPPING1, RFM69HW_DIOMAPPING1_DIO0_00);
+
+    // Repeat the packet for the duration, in milliseconds, so that it lands
+    // in at least one RX window of a receiver in listen mode. The duration
+    // should be at least the receiver's idle time plus its RX time.
+    bool ok = true;
+    const uint32_t start = hal.millis();
+    do {
+        ok = standby();
+        if (!ok)
+            break;
+
+        armAutoTransmit(true);
+        if (autoTransmit)
+            setBoost(true);
+        packetSent = false;
+        writeFifo(broadcastAddress, buffer, size);
+        ok = (autoTransmit || setOpMode(RFM69HW_OPMODE_MODE_TX)) &&
+             waitForFlag(WaitPacketSent, packetSent, true, timeout);
+    } while (ok && hal.millis() - start < duration);
+
+    restoreMode(mode);
+
+    return ok ? size : 0;
 }
 
-uint16_t RFM69HW::read16(const uint8_t reg) {
-    uint16_t value = 0;
-    volatile SPIGuard guard(slaveSelectPin);
-    SPI.transfer(reg);
-    value |= (uint16_t)SPI.transfer(0x00) << 8;
-    value |= (uint16_t)SPI.transfer(0x00);
-    return value;
+bool RFM69HW::setDataMode(const DataMode mode) {
+    PROFILE(ProfileConfiguration);
+
+    // The data mode can only be changed while the radio is idle
+    if (mode > Continuous || !waitIdle() || !standby())
+        return false;
+
+    static const uint8_t dataModes[] = {
+        RFM69HW_DATAMODUL_DATA_MODE_PACKET,
+        RFM69HW_DATAMODUL_DATA_MODE_CONTINUOUS_SYNC,
+        RFM69HW_DATAMODUL_DATA_MODE_CONTINUOUS_NO_SYNC,
+    };
+
+    const uint8_t dataModul = read8(RFM69HW_DATAMODUL) & ~RFM69HW_DATAMODUL_DATA_MODE_MASK;
+    write8(RFM69HW_DATAMODUL, dataModul | dataModes[mode]);
+
+    // In the continuous modes the bits go straight to and from the modem.
+    // DIO2 carries the data. With the bit synchronizer, DIO1 carries the
+    // recovered clock, which the data is sampled on in RX and has to be
+    // presented on in TX. Any synchronous peripheral of the MCU can be hooked
+    // up to the two pins. Without the bit synchronizer the data on DIO2 is
+    // the raw demodulator output, to be oversampled by the MCU.
+    const uint8_t dioMapping = read8(RFM69HW_DIOMAPPING1) &
+                               ~(RFM69HW_DIOMAPPING1_DIO1_MASK | RFM69HW_DIOMAPPING1_DIO2_MASK);
+    write8(RFM69HW_DIOMAPPING1, dioMapping | RFM69HW_DIOMAPPING1_DIO1_00 |
+                                (mode == PacketMode ? RFM69HW_DIOMAPPING1_DIO2_00 : RFM69HW_DIOMAPPING1_DIO2_01));
+
+    continuous = mode != PacketMode;
+    return true;
 }
 
-uint32_t RFM69HW::read24(const uint8_t reg) {
-    uint32_t value = 0;
-    volatile SPIGuard guard(slaveSelectPin);
-    SPI.transfer(reg);
-    value |= (uint32_t)SPI.transfer(0x00) << 16;
-    value |= (uint32_t)SPI.transfer(0x00) << 8;
-    value |= (uint32_t)SPI.transfer(0x00);
-    return value;
+bool RFM69HW::startTransmit() {
+    PROFILE(ProfileOpMode);
+
+    // Only meaningful in the continuous modes, where the transmitter sends
+    // whatever is on DIO2 for as long as it is keyed up. Call standby() or
+    // receive() to stop.
+    if (!continuous)
+        return false;
+
+    return setOpMode(RFM69HW_OPMODE_MODE_TX);
 }
 
-void RFM69HW::write8(const uint8_t reg, const uint8_t value) {
-    volatile SPIGuard guard(slaveSelectPin);
-    SPI.transfer(reg | 0x80);
-    SPI.transfer(value);
+void RFM69HW::setAutoModes(const AutoEnter enter, const AutoExit exit, const AutoMode mode) {
+    PROFILE(ProfileConfiguration);
+
+    static const uint8_t enterConditions[] = {
+        RFM69HW_AUTOMODES_ENTER_FIFO_NOT_EMPTY,
+        RFM69HW_AUTOMODES_ENTER_FIFO_LEVEL,
+        RFM69HW_AUTOMODES_ENTER_CRC_OK,
+        RFM69HW_AUTOMODES_ENTER_PAYLOAD_READY,
+        RFM69HW_AUTOMODES_ENTER_SYNC_ADDRESS,
+        RFM69HW_AUTOMODES_ENTER_PACKET_SENT,
+        RFM69HW_AUTOMODES_ENTER_FIFO_EMPTY,
+    };
+
+    static const uint8_t exitConditions[] = {
+        RFM69HW_AUTOMODES_EXIT_FIFO_EMPTY,
+        RFM69HW_AUTOMODES_EXIT_FIFO_LEVEL_OR_TIMEOUT,
+        RFM69HW_AUTOMODES_EXIT_CRC_OK_OR_TIMEOUT,
+        RFM69HW_AUTOMODES_EXIT_PAYLOAD_READY_OR_TIMEOUT,
+        RFM69HW_AUTOMODES_EXIT_SYNC_ADDRESS_OR_TIMEOUT,
+        RFM69HW_AUTOMODES_EXIT_PACKET_SENT,
+        RFM69HW_AUTOMODES_EXIT_TIMEOUT,
+    };
+
+    static const uint8_t intermediateModes[] = {
+        RFM69HW_AUTOMODES_INTERMEDIATE_SLEEP,
+        RFM69HW_AUTOMODES_INTERMEDIATE_STANDBY,
+        RFM69HW_AUTOMODES_INTERMEDIATE_RX,
+        RFM69HW_AUTOMODES_INTERMEDIATE_TX,
+    };
+
+    // When the device keys up by itself once the FIFO is loaded, and comes
+    // back once the packet is sent, transmissions only have to load the FIFO
+    // from standby
+    autoTransmit = enter == AutoEnterFifoNotEmpty &&
+                   exit == AutoExitPacketSent &&
+                   mode == AutoTransmit;
+
+    // The device moves from the main op mode into the intermediate mode when
+    // the enter condition occurs, and back again on the exit condition. The
+    // transmit combination is only armed right before the FIFO is loaded.
+    write8(RFM69HW_AUTOMODES, autoTransmit ? RFM69HW_AUTOMODES_ENTER_OFF :
+                              enterConditions[enter] | exitConditions[exit] | intermediateModes[mode]);
 }
 
-void RFM69HW::write16(const uint8_t reg, const uint16_t value) {
-    volatile SPIGuard guard(slaveSelectPin);
-    SPI.transfer(reg | 0x80);
-    SPI.transfer((value & 0xFF00) >> 8);
-    SPI.transfer((value & 0x00FF));
+void RFM69HW::disableAutoModes() {
+    PROFILE(ProfileConfiguration);
+
+    write8(RFM69HW_AUTOMODES, RFM69HW_AUTOMODES_ENTER_OFF);
+    autoTransmit = false;
 }
 
-void RFM69HW::write24(const uint8_t reg, const uint32_t value) {
-    volatile SPIGuard guard(slaveSelectPin);
-    SPI.transfer(reg | 0x80);
-    SPI.transfer((value & 0xFF0000) >> 16);
-    SPI.transfer((value & 0x00FF00) >> 8);
-    SPI.transfer((value & 0x0000FF));
+void RFM69HW::setAddress(const uint8_t node, const uint8_t broadcast) {
+    PROFILE(ProfileConfiguration);
+
+    // Have the device drop every packet which is neither addressed to this
+    // node nor broadcast. Packets then carry the address after the length.
+    const uint8_t addresses[2] = { node, broadcast };
+    writeBurst(RFM69HW_NODEADRS, addresses, sizeof(addresses));
+
+    const uint8_t packetConfig = read8(RFM69HW_PACKETCONFIG1) & ~RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK;
+    write8(RFM69HW_PACKETCONFIG1, packetConfig | RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_BOTH);
+
+    broadcastAddress = broadcast;
+    addressing = true;
+}
+
+void RFM69HW::disableAddressing() {
+    PROFILE(ProfileConfiguration);
+
+    const uint8_t packetConfig = read8(RFM69HW_PACKETCONFIG1) & ~RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK;
+    write8(RFM69HW_PACKETCONFIG1, packetConfig | RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_NONE);
+
+    addressing = false;
+}
+
+void RFM69HW::setSyncWord(const uint8_t* sync, const uint8_t size) {
+    PROFILE(ProfileConfiguration);
+
+    // The sync word can be 1 to 8 bytes long. A size of 0 turns it off.
+    if (size == 0) {
+        write8(RFM69HW_SYNCCONFIG, RFM69HW_SYNCCONFIG_SYNC_OFF);
+        return;
+    }
+
+    const uint8_t count = size < 8 ? size : 8;
+    writeBurst(RFM69HW_SYNCVALUE1, sync, count);
+    write8(RFM69HW_SYNCCONFIG, RFM69HW_SYNCCONFIG_SYNC_ON |
+                               ((count - 1) << RFM69HW_SYNCCONFIG_SYNC_SIZE_SHIFT));
+}
+
+void RFM69HW::setEncryptionKey(const uint8_t* key) {
+    PROFILE(ProfileConfiguration);
+
+    // Load the 16 byte key in one burst and turn the AES engine on. The key
+    // can only be changed while the device is in standby or sleep.
+    const uint8_t mode = currentMode();
+    standby();
+
+    writeBurst(RFM69HW_AESKEY1, key, RFM69HW_AES_KEY_SIZE);
+    write8(RFM69HW_PACKETCONFIG2, read8(RFM69HW_PACKETCONFIG2) | RFM69HW_PACKETCONFIG2_AES_ON);
+    encrypting = true;
+
+    restoreMode(mode);
+}
+
+void RFM69HW::disableEncryption() {
+    PROFILE(ProfileConfiguration);
+
+    write8(RFM69HW_PACKETCONFIG2, read8(RFM69HW_PACKETCONFIG2) & ~RFM69HW_PACKETCONFIG2_AES_ON);
+    encrypting = false;
+}
+
+// Conversions between Hz and synthesizer steps, used by both the carrier
+// frequency and the frequency deviation. Both are split into a whole and a
+// fractional part so that they are exact without 64-bit arithmetic.
+static uint32_t toFrf(const uint32_t hz) {
+    return (hz / FSTEP_NUM) * FSTEP_DEN +
+           ((hz % FSTEP_NUM) * FSTEP_DEN + FSTEP_NUM / 2) / FSTEP_NUM;
+}
+
+static uint32_t fromFrf(const uint32_t frf) {
+    return (frf / FSTEP_DEN) * FSTEP_NUM +
+           ((frf % FSTEP_DEN) * FSTEP_NUM + FSTEP_DEN / 2) / FSTEP_DEN;
+}
+
+// Validated modem settings. The receiver bandwidth covers Fdev + Bitrate / 2
+// and the AFC bandwidth leaves room for crystal offsets on top. The modulation
+// index, 2 * Fdev / Bitrate, stays between 1 and 10. The sensitivity is an
+// approximate figure for the RFM69HW at 1% PER, used to judge link margin.
+struct ModemSettings {
+    uint32_t bitrate;
+    uint32_t fdev;
+    uint8_t rxBw;
+    uint8_t afcBw;
+    int8_t sensitivity;
+};
+
+static const ModemSettings modems[RFM69HW::ModemCount] = {
+    {   1200,   5000, RFM69HW_RXBW_MANT_24 | 5, RFM69HW_AFCBW_MANT_24 | 4, -118 }, //  10.4 /  20.8 kHz
+    {   4800,   5000, RFM69HW_RXBW_MANT_16 | 5, RFM69HW_AFCBW_MANT_16 | 4, -112 }, //  15.6 /  31.3 kHz
+    {   9600,  20000, RFM69HW_RXBW_MANT_16 | 4, RFM69HW_AFCBW_MANT_16 | 3, -109 }, //  31.3 /  62.5 kHz
+    {  38400,  40000, RFM69HW_RXBW_MANT_24 | 2, RFM69HW_AFCBW_MANT_16 | 2, -103 }, //  83.3 / 125.0 kHz
+    { 100000, 100000, RFM69HW_RXBW_MANT_24 | 1, RFM69HW_AFCBW_MANT_16 | 1,  -98 }, // 166.7 / 250.0 kHz
+    { 200000, 100000, RFM69HW_RXBW_MANT_16 | 1, RFM69HW_AFCBW_MANT_24 | 0,  -94 }, // 250.0 / 333.3 kHz
+    { 300000, 150000, RFM69HW_RXBW_MANT_20 | 0, RFM69HW_AFCBW_MANT_16 | 0,  -91 }, // 400.0 / 500.0 kHz
+};
+
+uint32_t RFM69HW::baudRate() {
+    PROFILE(ProfileOther);
+
+    return bitrate;
+}
+
+void RFM69HW::setBaudRate(const uint32_t value) {
+    PROFILE(ProfileConfiguration);
+
+    // The bit rate alone does not make a working link. Take the deviation and
+    // bandwidths of the slowest modem profile which is at least as fast, so
+    // the receiver filter still passes the whole signal.
+    uint8_t modem = 0;
+    while (modem < ModemCount - 1 && modems[modem].bitrate < value)
+        ++modem;
+
+    writeModem(value, modems[modem].fdev, modems[modem].rxBw, modems[modem].afcBw);
+}
+
+bool RFM69HW::setModem(const Modem modem) {
+    PROFILE(ProfileConfiguration);
+
+    if (modem >= ModemCount)
+        return false;
+
+    const ModemSettings& settings = modems[modem];
+    writeModem(settings.bitrate, settings.fdev, settings.rxBw, settings.afcBw);
+    return true;
+}
+
+int8_t RFM69HW::transmitPower() {
+    return txPower;
+}
+
+bool RFM69HW::setTransmitPower(const int8_t dbm) {
+    PROFILE(ProfileConfiguration);
+
+    // Only PA1 and PA2 are wired to the antenna on the HW module. PA1 alone
+    // covers -2 to +13 dBm, PA1 and PA2 together +2 to +17 dBm, and both with
+    // the boost +5 to +20 dBm.
+    if (dbm < -2 || dbm > 20)
+        return false;
+
+    uint8_t paLevel;
+    if (dbm <= 13)
+        paLevel = RFM69HW_PALEVEL_PA1_ON | (dbm + 18);
+    else if (dbm <= 17)
+        paLevel = RFM69HW_PALEVEL_PA1_ON | RFM69HW_PALEVEL_PA2_ON | (dbm + 14);
+    else
+        paLevel = RFM69HW_PALEVEL_PA1_ON | RFM69HW_PALEVEL_PA2_ON | (dbm + 11);
+
+    // The boost draws more current than the over current protection allows
+    write8(RFM69HW_PALEVEL, paLevel);
+    write8(RFM69HW_OCP, (dbm > 17 ? RFM69HW_OCP_OFF : RFM69HW_OCP_ON) | RFM69HW_OCP_TRIM_95MA);
+
+    txPower = dbm;
+    highPower = dbm > 17;
+
+    // Put the boost in or take it out right away if already transmitting, as
+    // in the continuous modes
+    setBoost(opMode == RFM69HW_OPMODE_MODE_TX && !listening);
+    return true;
+}
+
+int8_t RFM69HW::sensitivity(const Modem modem) {
+    return modems[modem < ModemCount ? modem : ModemCount - 1].sensitivity;
+}
+
+void RFM69HW::writeModem(const uint32_t bitrate, const uint32_t fdev, const uint8_t rxBw, const uint8_t afcBw) {
+    // The bit rate and deviation registers are adjacent, and so are the two
+    // bandwidth registers, so each pair goes out in a single burst
+    const uint16_t bitrateValue = FXOSC_HZ / bitrate;
+    const uint16_t fdevValue = toFrf(fdev);
+    const uint8_t modulation[4] = {
+        (uint8_t)(bitrateValue >> 8), (uint8_t)bitrateValue,
+        (uint8_t)(fdevValue >> 8), (uint8_t)fdevValue,
+    };
+    writeBurst(RFM69HW_BITRATEMSB, modulation, sizeof(modulation));
+    this->bitrate = FXOSC_HZ / bitrateValue;
+
+    const uint8_t bandwidth[2] = {
+        (uint8_t)(RFM69HW_RXBW_DCC_FREQ_4 | rxBw),
+        (uint8_t)(RFM69HW_AFCBW_DCC_FREQ_1 | afcBw),
+    };
+    writeBurst(RFM69HW_RXBW, bandwidth, sizeof(bandwidth));
+}
+
+uint32_t RFM69HW::carrierFrequency() {
+    PROFILE(ProfileOther);
+
+    return fromFrf(read24(RFM69HW_FRFMSB));
+}
+
+bool RFM69HW::setCarrierFrequency(const uint32_t value) {
+    PROFILE(ProfileSetCarrierFrequency);
+
+    carrierFrf = toFrf(value);
+    return hop(carrierFrf);
+}
+
+uint32_t RFM69HW::carrierFrequencyMHz() {
+    return carrierFrequency() / MILLION;
+}
+
+bool RFM69HW::setCarrierFrequencyMHz(const uint32_t value) {
+    return setCarrierFrequency(value * MILLION);
+}
+
+bool RFM69HW::setChannels(const uint32_t* frequencies, uint32_t* frf, const uint8_t count, const uint8_t seed) {
+    PROFILE(ProfileConfiguration);
+
+    if (!frequencies || !frf || count == 0)
+        return false;
+
+    // Convert the table from Hz into the caller's FRF table, so that hopping
+    // is only ever register writes. The frequencies are left as they are.
+    for (uint8_t i = 0; i < count; ++i)
+        frf[i] = toFrf(frequencies[i]);
+
+    // hopNext() walks a linear congruential sequence over the smallest power
+    // of two which covers the table, skipping the indices past its end. Any
+    // odd increment gives a sequence which visits every channel once per
+    // cycle, so each seed picks a different order.
+    uint8_t mask = 0;
+    while (mask < count - 1)
+        mask = (mask << 1) | 1;
+
+    channels = frf;
+    channelCount = count;
+    channelIndex = 0;
+    hopMask = mask;
+    hopIncrement = 2 * seed + 1;
+
+    return true;
+}
+
+bool RFM69HW::hopTo(const uint8_t index) {
+    PROFILE(ProfileSetCarrierFrequency);
+
+    if (index >= channelCount)
+        return false;
+
+    channelIndex = index;
+    carrierFrf = channels[index];
+    return hop(carrierFrf);
+}
+
+bool RFM69HW::hopNext() {
+    PROFILE(ProfileSetCarrierFrequency);
+
+    if (channelCount == 0)
+        return false;
+
+    // At most half of the sequence lies past the end of the table
+    uint8_t index = channelIndex;
+    do {
+        index = (HOP_MULTIPLIER * index + hopIncrement) & hopMask;
+    } while (index >= channelCount);
+
+    channelIndex = index;
+    carrierFrf = channels[index];
+    return hop(carrierFrf);
+}
+
+uint8_t RFM69HW::channel() {
+    return channelIndex;
+}
+
+void RFM69HW::setDriftTracking(const bool enabled) {
+    PROFILE(ProfileConfiguration);
+
+    // Have the AFC measure and correct the frequency error of every packet at
+    // the start of its preamble. The value it settles on is the offset of the
+    // sender from our own carrier. Sniffing needs the AFC as well.
+    write8(RFM69HW_AFCFEI, enabled || sniffing ?
+                           RFM69HW_AFCFEI_AFC_AUTO_ON | RFM69HW_AFCFEI_AFC_AUTOCLEAR_ON : 0);
+    driftTracking = enabled;
+}
+
+int32_t RFM69HW::frequencyOffset(const uint8_t address) {
+    const int16_t offset = driftOffset(address);
+    return offset < 0 ? -(int32_t)fromFrf(-offset) : (int32_t)fromFrf(offset);
+}
+
+bool RFM69HW::tuneTo(const uint8_t address) {
+    PROFILE(ProfileSetCarrierFrequency);
+
+    // Centre the receiver on a peer which is about to answer, so that its
+    // offset does not have to fit in the AFC bandwidth
+    return hop(carrierFrf + driftOffset(address));
+}
+
+void RFM69HW::trackDrift(const uint8_t address, const int16_t measured) {
+    for (uint8_t i = 0; i < driftCount; ++i) {
+        Drift& entry = drift[i];
+        if (entry.address == address && entry.band == driftBand) {
+            entry.offset += (measured - entry.offset) / DRIFT_SMOOTHING;
+            return;
+        }
+    }
+
+    // New peer or temperature band. Once the table is full the entries are
+    // reused oldest first.
+    Drift* entry;
+    if (driftCount < RFM69HW_DRIFT_ENTRIES) {
+        entry = &drift[driftCount++];
+    } else {
+        entry = &drift[driftNext];
+        driftNext = (driftNext + 1) % RFM69HW_DRIFT_ENTRIES;
+    }
+
+    entry->address = address;
+    entry->band = driftBand;
+    entry->offset = measured;
+}
+
+int16_t RFM69HW::driftOffset(const uint8_t address) {
+    if (!driftTracking)
+        return 0;
+
+    // Prefer the offset for the current temperature band. Otherwise fall back
+    // on the one for the nearest band the peer has been heard in.
+    const Drift* nearest = NULL;
+    uint8_t distance = UINT8_MAX;
+    for (uint8_t i = 0; i < driftCount; ++i) {
+        const Drift& entry = drift[i];
+        if (entry.address != address)
+            continue;
+
+        const uint8_t d = entry.band > driftBand ? entry.band - driftBand : driftBand - entry.band;
+        if (d < distance) {
+            nearest = &entry;
+            distance = d;
+        }
+    }
+
+    return nearest ? nearest->offset : 0;
+}
+
+bool RFM69HW::setSniffing(const bool enabled) {
+    PROFILE(ProfileConfiguration);
+
+    // Accept every frame, whoever it is addressed to, and keep the frames
+    // which fail the CRC check rather than dropping them so that they can be
+    // reported as such
+    uint8_t packetConfig = read8(RFM69HW_PACKETCONFIG1) & ~(RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK |
+                                                            RFM69HW_PACKETCONFIG1_CRC_AUTO_CLEAR_OFF);
+    if (enabled)
+        packetConfig |= RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_NONE | RFM69HW_PACKETCONFIG1_CRC_AUTO_CLEAR_OFF;
+    else if (addressing)
+        packetConfig |= RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_BOTH;
+    write8(RFM69HW_PACKETCONFIG1, packetConfig);
+
+    // Run the AFC on every frame. It measures the frequency offset of the
+    // sender, and keeps senders which have drifted within the receiver
+    // bandwidth.
+    write8(RFM69HW_AFCFEI, enabled || driftTracking ?
+                           RFM69HW_AFCFEI_AFC_AUTO_ON | RFM69HW_AFCFEI_AFC_AUTOCLEAR_ON : 0);
+
+    // Frames already in the receive queue were stored the other way, with or
+    // without a capture, so they are dropped
+    sniffing = enabled;
+    while (nextReceived())
+        ;
+    sniffDropped = rxDropped;
+
+    if (!enabled)
+        return true;
+
+    return receive();
+}
+
+// Start of every record written by sniff(), so that a reader which joins part
+// way through the stream can find the next one
+#define SNIFF_SYNC  (0xA5)
+
+bool RFM69HW::sniff(Print& out) {
+    const Handle handle = borrow();
+    if (handle == RFM69HW_NO_PACKET)
+        return false;
+
+    const Packet& packet = pool[handle];
+    const Capture& capture = captures[handle];
+
+    // Frames dropped since the previous record, as the pool was full
+    const uint8_t dropped = capture.dropped - sniffDropped;
+    sniffDropped = capture.dropped;
+
+    // A record is the sync byte, the length of the frame, the timestamp in
+    // microseconds, the RSSI in dBm, the frequency offset in synthesizer
+    // steps, the CRC status and the number of dropped frames. The frame
+    // itself follows, then an XOR of every byte after the sync byte.
+    // Multi-byte fields are little-endian.
+    const uint8_t header[] = {
+        SNIFF_SYNC,
+        packet.size,
+        (uint8_t)capture.time,
+        (uint8_t)(capture.time >> 8),
+        (uint8_t)(capture.time >> 16),
+        (uint8_t)(capture.time >> 24),
+        (uint8_t)capture.rssi,
+        (uint8_t)capture.offset,
+        (uint8_t)(capture.offset >> 8),
+        capture.crcOk,
+        dropped,
+    };
+
+    uint8_t check = 0;
+    for (uint8_t i = 1; i < sizeof(header); ++i)
+        check ^= header[i];
+    for (uint8_t i = 0; i < packet.size; ++i)
+        check ^= packet.data[i];
+
+    out.write(header, sizeof(header));
+    out.write(packet.data, packet.size);
+    out.write(check);
+
+    release(handle);
+    return true;
+}
+
+bool RFM69HW::hop(const uint32_t frf) {
+    tunedFrf = frf;
+
+    // Handle hopping under different op modes. The op mode is tracked by the
+    // driver, so working out how to hop costs no bus traffic.
+    switch (listening ? RFM69HW_OPMODE_MODE_STANDBY : opMode) {
+    case RFM69HW_OPMODE_MODE_TX:
+        // Transmitter channel hop sequence:
+        //   1) Set the op mode to RX
+        //   2) Change the carrier frequency
+        //   3) Set the op mode back to TX
+        //   4) Wait for the TX start procedure to finish
+        if (!setOpMode(RFM69HW_OPMODE_MODE_RX))
+            return false;
+        write24(RFM69HW_FRFMSB, frf);
+        return setOpMode(RFM69HW_OPMODE_MODE_TX) &&
+               waitFor(WaitHop, RFM69HW_IRQFLAGS1, RFM69HW_IRQFLAGS1_TX_READY, true, HOP_TIMEOUT_US);
+    case RFM69HW_OPMODE_MODE_RX:
+        // Receiver channel hop sequence:
+        //   1) Change the carrier frequency
+        //   2) Restart the receiver, which relocks the PLL on the new channel
+        //      without a round trip through FS mode
+        //   3) Wait for the RX start procedure to finish
+        write24(RFM69HW_FRFMSB, frf);
+        writeTrigger(RFM69HW_PACKETCONFIG2, RFM69HW_PACKETCONFIG2_RESTART_RX);
+        return waitFor(WaitHop, RFM69HW_IRQFLAGS1, RFM69HW_IRQFLAGS1_RX_READY, true, HOP_TIMEOUT_US);
+    default:
+        // Change the carrier frequency. It can take up to 80 us before the
+        // channel hop is completed
+        write24(RFM69HW_FRFMSB, frf);
+        hal.delayMicroseconds(80);
+        return true;
+    }
+}
+
+int8_t RFM69HW::receivedSignalStrength() {
+    PROFILE(ProfileReceivedSignalStrength);
+
+    uint8_t value;
+    if (!sampleRssi(value))
+        return RFM69HW_READING_FAILED;
+
+    // Convert the measured value to decibal-milliwatts. The equation used is:
+    // y = -x / 2. This equation comes from the RSSI value register
+    // documentation in the datasheet.
+    return -((int16_t)value) / 2;
+}
+
+size_t RFM69HW::scan(const uint32_t* frequencies, const uint8_t count, int8_t* rssi) {
+    PROFILE(ProfileReceivedSignalStrength);
+
+    // Remember where the radio was so that it can be put back afterwards
+    const uint8_t mode = currentMode();
+    const uint32_t frf = tunedFrf;
+
+    // RSSI is only measured by the receiver. Once it is running, each step is
+    // a hop with a receiver restart followed by a single measurement.
+    size_t taken = 0;
+    if (setOpMode(RFM69HW_OPMODE_MODE_RX)) {
+        for (; taken < count; ++taken) {
+            uint8_t value;
+            if (!hop(toFrf(frequencies[taken])) || !sampleRssi(value))
+                break;
+
+            rssi[taken] = -((int16_t)value) / 2;
+        }
+    }
+
+    standby();
+    write24(RFM69HW_FRFMSB, tunedFrf = frf);
+    restoreMode(mode);
+
+    return taken;
+}
+
+bool RFM69HW::setListenBeforeTalk(const int8_t threshold, const uint32_t timeout) {
+    PROFILE(ProfileConfiguration);
+
+    // The threshold is in dBm and stored in the same -2 dB steps as the RSSI.
+    // It is kept apart from the RSSI threshold register, which the receiver
+    // uses to detect the start of a packet.
+    if (threshold > 0 || timeout == 0)
+        return false;
+
+    lbtThreshold = -2 * threshold;
+    lbtTimeout = timeout;
+
+    return true;
+}
+
+void RFM69HW::disableListenBeforeTalk() {
+    lbtTimeout = 0;
+}
+
+bool RFM69HW::channelClear() {
+    PROFILE(ProfileReceivedSignalStrength);
+
+    // The RSSI register counts down in -2 dB steps, so a value above the
+    // threshold is a signal below it
+    uint8_t value;
+    return opMode == RFM69HW_OPMODE_MODE_RX && !listening &&
+           sampleRssi(value) && value > lbtThreshold;
+}
+
+bool RFM69HW::sampleRssi(uint8_t& value) {
+    // Take the measurement
+    write8(RFM69HW_RSSICONFIG, RFM69HW_RSSICONFIG_RSSI_START);
+    if (!waitFor(WaitRssi, RFM69HW_RSSICONFIG, RFM69HW_RSSICONFIG_RSSI_DONE, true, RSSI_TIMEOUT_US))
+        return false;
+
+    value = read8(RFM69HW_RSSIVALUE);
+    return true;
+}
+
+bool RFM69HW::waitChannelClear() {
+    // The channel can only be sensed with the receiver running
+    if ((listening || opMode != RFM69HW_OPMODE_MODE_RX) &&
+        !setOpMode(RFM69HW_OPMODE_MODE_RX))
+        return false;
+
+    // Keep sampling until the channel is quiet, or give up after the timeout
+    // in milliseconds
+    const uint32_t start = hal.millis();
+    bool clear = channelClear();
+    while (!clear && hal.millis() - start < lbtTimeout)
+        clear = channelClear();
+
+    recordWait(WaitChannelClear, (hal.millis() - start) * 1000);
+    return clear;
+}
+
+uint8_t RFM69HW::version() {
+    PROFILE(ProfileOther);
+
+    return read8(RFM69HW_VERSION);
+}
+
+int8_t RFM69HW::temperature() {
+    PROFILE(ProfileTemperature);
+
+    // This procedure can only be run in standby or FS op mode. The radio is
+    // put back into the mode it was in afterwards.
+    const uint8_t mode = currentMode();
+    if (!standby())
+        return RFM69HW_READING_FAILED;
+
+    // Take the measurement. According to the datasheet, this should finish in
+    // less then 100 us.
+    write8(RFM69HW_TEMP1, RFM69HW_TEMP1_MEAS_START);
+    const bool measured = waitFor(WaitTemperature, RFM69HW_TEMP1, RFM69HW_TEMP1_MEAS_RUNNING, false, TEMPERATURE_TIMEOUT_US);
+    const uint8_t value = read8(RFM69HW_TEMP2);
+    restoreMode(mode);
+    if (!measured)
+        return RFM69HW_READING_FAILED;
+
+    // Convert the measured value to degrees Celsius. The conversion involves
+    // taking the measurement and passing it through the equation:
+    // y = -x + 170. This equation does not come from the datasheet. It was
+    // found through testing where a value of 150 was found to be equal to a
+    // temperature of 20 C, and 140 was found to be equal to 30 C. The
+    // temperature sensor measures temperature using an ADC as -1 C per LSB, so
+    // the equation is obviously linear.
+    const int8_t celsius = -((int16_t)value) + 170;
+
+    // Offsets learned from now on belong to this temperature band
+    const int16_t band = (celsius - DRIFT_BAND_MIN_C) / DRIFT_BAND_WIDTH_C;
+    driftBand = band < 0 ? 0 : band;
+
+    return celsius;
+}
+
+bool RFM69HW::calibrateOscillator() {
+    PROFILE(ProfileCalibrateOscillator);
+
+    // This procedure can only be run in standby mode
+    if (!standby())
+        return false;
+
+    // Trigger calibration and wait for it to finish. Unknown exactly how long
+    // this may take. Worst case time would be 500 us.
+    write8(RFM69HW_OSC1, RFM69HW_OSC1_RC_CAL_START);
+    return waitFor(WaitCalibration, RFM69HW_OSC1, RFM69HW_OSC1_RC_CAL_DONE, true, CALIBRATION_TIMEOUT_US);
+}
+
+void RFM69HW::resync() {
+    PROFILE(ProfileConfiguration);
+
+#if RFM69HW_SHADOW_REGISTERS
+    {
+        volatile SPIGuard guard(hal, slaveSelectPin);
+        guard.transfer(SHADOW_FIRST);
+        guard.receive(shadow, sizeof(shadow));
+    }
+#endif
+
+    opMode = read8(RFM69HW_OPMODE) & RFM69HW_OPMODE_MODE_MASK;
+    boosted = read8(RFM69HW_TESTPA1) == RFM69HW_TESTPA1_BOOST;
+    tunedFrf = read24(RFM69HW_FRFMSB);
+}
+
+#if RFM69HW_INSTRUMENTATION
+const RFM69HW::Profile& RFM69HW::profile(const ProfileId id) {
+    return profiles[id];
+}
+
+uint32_t RFM69HW::worstWait(const WaitId id) {
+    return waits[id];
+}
+
+void RFM69HW::resetProfiles() {
+    memset(profiles, 0, sizeof(profiles));
+    memset(waits, 0, sizeof(waits));
+}
+#endif
+
+template<uint8_t N> void RFM69HW::isr() {
+    RFM69HW* radio = instances[N];
+    if (!radio)
+        return;
+
+    // Timestamp received frames as close to the end of the frame as possible
+    const uint32_t now = radio->hal.micros();
+
+    // Radios in a group share the bus, so their interrupts are only queued up
+    // here. The group services them in the order they came in.
+    if (radio->group) {
+        uint8_t event = eventCount + 1;
+        if (event == 0)
+            ++event;
+        eventCount = event;
+        radio->pendingTime = now;
+        radio->pendingEvent = event;
+        return;
+    }
+
+    radio->handleInterrupt(now);
+}
+
+void RFM69HW::handleInterrupt(const uint32_t now) {
+    PROFILE_INTERRUPT();
+
+    const uint8_t flags = read8(RFM69HW_IRQFLAGS2);
+
+    // receiveStream() drains the FIFO itself
+    const bool payloadReady = (flags & RFM69HW_IRQFLAGS2_PAYLOAD_READY) && !rxStreaming;
+
+    if (payloadReady && sniffing) {
+        // The AFC and RSSI values only hold until the receiver restarts, so
+        // they are read before the FIFO is drained. The registers from the AFC
+        // through to the RSSI value are read in one go.
+        uint8_t measured[RFM69HW_RSSIVALUE - RFM69HW_AFCMSB + 1];
+        readBurst(RFM69HW_AFCMSB, measured, sizeof(measured));
+
+        Capture capture;
+        capture.time = now;
+        capture.offset = (int16_t)(((uint16_t)measured[0] << 8) | measured[1]);
+        capture.rssi = -((int16_t)measured[RFM69HW_RSSIVALUE - RFM69HW_AFCMSB]) / 2;
+        capture.crcOk = flags & RFM69HW_IRQFLAGS2_CRC_OK;
+        receivePayload(capture);
+    } else if (payloadReady) {
+        Capture capture = {};
+        capture.time = now;
+
+        // The AFC value, a signed number of synthesizer steps, only holds
+        // until the receiver restarts. That happens once the FIFO is empty.
+        const int16_t afc = driftTracking ? (int16_t)read16(RFM69HW_AFCMSB) : 0;
+        const uint8_t address = receivePayload(capture);
+
+        // The AFC measures from wherever the receiver is tuned, which is off
+        // the carrier after tuneTo(). Offsets are kept relative to the carrier.
+        if (driftTracking)
+            trackDrift(address, afc + (int16_t)(tunedFrf - carrierFrf));
+    }
+
+    // With AutoModes the device has already dropped out of TX by the time
+    // the flags are read, which clears PacketSent. DIO0 signals nothing else
+    // in standby, so the interrupt itself says the packet went out.
+    const bool autoSent = autoTransmit && opMode == RFM69HW_OPMODE_MODE_STANDBY && !listening;
+
+    // Loading the next queued packet means waiting on mode changes, which
+    // must not happen in interrupt context. That is left to serviceTransmit().
+    if ((flags & RFM69HW_IRQFLAGS2_PACKET_SENT) || autoSent)
+        packetSent = true;
+}
+
+uint8_t RFM69HW::receivePayload(const Capture& capture) {
+    // Drain the whole packet from the FIFO in a single transaction. The first
+    // byte is the length of the payload which follows it, including the
+    // address byte if there is one. Captured frames are kept whole, address
+    // byte and all.
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(RFM69HW_FIFO);
+    uint8_t size = guard.transfer(0x00);
+    if (size > RFM69HW_MAX_PAYLOAD)
+        size = RFM69HW_MAX_PAYLOAD;
+
+    uint8_t address = broadcastAddress;
+    if (addressing && !sniffing && size > 0) {
+        address = guard.transfer(0x00);
+        --size;
+    }
+
+    // Packets which do not fit in the pool, or in the receive queue, are read
+    // out of the FIFO anyway and dropped, so that the receiver can restart.
+    const uint8_t head = rxHead;
+    const Handle handle = (uint8_t)(head - rxTail) < RFM69HW_PACKET_POOL_SIZE ? claim() : RFM69HW_NO_PACKET;
+    if (handle == RFM69HW_NO_PACKET) {
+        for (uint8_t i = 0; i < size; ++i)
+            guard.transfer(0x00);
+        rxDropped = rxDropped + 1;
+        return address;
+    }
+
+    // Read straight into the packet buffer
+    Packet& packet = pool[handle];
+    packet.address = address;
+    packet.size = size;
+    guard.receive(packet.data, size);
+
+    captures[handle] = capture;
+    captures[handle].dropped = rxDropped;
+
+    // Publish the new packet only once it has been stored
+    rxQueue[head & POOL_MASK] = handle;
+    rxHead = head + 1;
+
+    return address;
+}
+
+RFM69HW::Handle RFM69HW::claim() {
+    // Called by the interrupt handler. Leaves alone the buffer allocate() may
+    // be in the middle of claiming.
+    for (Handle handle = 0; handle < RFM69HW_PACKET_POOL_SIZE; ++handle) {
+        if (!poolUsed[handle] && handle != poolClaim) {
+            poolUsed[handle] = true;
+            return handle;
+        }
+    }
+
+    return RFM69HW_NO_PACKET;
+}
+
+bool RFM69HW::nextReceived() {
+    // Release the packet which was being read as a stream and take the next
+    // one off the receive queue
+    if (rxCurrent != RFM69HW_NO_PACKET) {
+        release(rxCurrent);
+        rxCurrent = RFM69HW_NO_PACKET;
+    }
+
+    if (rxHead == rxTail)
+        return false;
+
+    rxCurrent = rxQueue[rxTail & POOL_MASK];
+    rxOffset = 0;
+    rxTail = rxTail + 1;
+    return true;
+}
+
+void RFM69HW::transmitNext() {
+    const Handle handle = txQueue[txTail & TX_QUEUE_MASK];
+    const Packet& packet = pool[handle];
+
+    // Load the FIFO from standby, then key up. The queue slot and the packet
+    // buffer are released as soon as the payload is in the FIFO.
+    standby();
+    armAutoTransmit(true);
+    if (autoTransmit)
+        setBoost(true);
+    packetSent = false;
+    writeFifo(packet.address, packet.data, packet.size);
+    release(handle);
+    txTail = txTail + 1;
+    if (!autoTransmit)
+        setOpMode(RFM69HW_OPMODE_MODE_TX);
+}
+
+void RFM69HW::serviceTransmit() {
+    // Runs outside of interrupt context, once the interrupt handler has seen
+    // the packet on air go out
+    if (!txActive || !packetSent)
+        return;
+    packetSent = false;
+
+    // Send the queued packets back-to-back
+    if (txHead != txTail) {
+        transmitNext();
+        return;
+    }
+
+    // Queue drained. Put the radio back into the mode it was in before.
+    restoreMode(txReturnMode);
+
+    txActive = false;
+
+    if (txCallback)
+        txCallback();
+}
+
+uint8_t RFM69HW::maxPayload() {
+    // The address byte takes up room in the FIFO, and in the message handed
+    // to the AES engine
+    if (encrypting)
+        return RFM69HW_MAX_AES_PAYLOAD - addressing;
+
+    return RFM69HW_MAX_PAYLOAD - addressing;
+}
+
+void RFM69HW::writeFifo(const uint8_t address, const uint8_t* buffer, const uint8_t size) {
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(RFM69HW_FIFO | 0x80);
+    guard.transfer(size + addressing);
+    if (addressing)
+        guard.transfer(address);
+    guard.send(buffer, size);
+}
+
+bool RFM69HW::drainFifo(uint8_t* buffer, const size_t count) {
+    // Read bytes out of the FIFO as they come in. Whole chunks are read once
+    // the FIFO is above the threshold level, the rest one byte at a time. A
+    // null buffer throws the bytes away.
+    const uint32_t timeout = 2 * FIFO_SIZE * byteTime() + TX_MARGIN_US;
+    uint8_t discard[FIFO_THRESHOLD];
+    size_t read = 0;
+    while (read < count) {
+        const size_t remaining = count - read;
+        const bool chunk = remaining >= FIFO_THRESHOLD;
+        if (!waitFor(WaitFifoLevel, RFM69HW_IRQFLAGS2,
+                     chunk ? RFM69HW_IRQFLAGS2_FIFO_LEVEL : RFM69HW_IRQFLAGS2_FIFO_NOT_EMPTY, true, timeout))
+            return false;
+
+        const size_t size = chunk ? FIFO_THRESHOLD : 1;
+        readBurst(RFM69HW_FIFO, buffer ? &buffer[read] : discard, size);
+        read += size;
+    }
+
+    return true;
+}
+
+bool RFM69HW::setOpMode(const uint8_t value) {
+    // Leaving listen mode requires aborting it in the same write as the new
+    // mode, followed by a second write with the abort bit cleared
+    if (listening) {
+        write8(RFM69HW_OPMODE, RFM69HW_OPMODE_LISTEN_ABORT | value);
+        listening = false;
+    }
+
+    // The PA boost is only allowed in TX. The receiver in particular does not
+    // work with it in place.
+    setBoost((value & RFM69HW_OPMODE_MODE_MASK) == RFM69HW_OPMODE_MODE_TX);
+
+    if ((value & RFM69HW_OPMODE_MODE_MASK) == RFM69HW_OPMODE_MODE_RX)
+        armAutoTransmit(false);
+
+    // Set the operating mode. Wait until the mode ready interrupt occurs
+    // before continuing.
+    write8(RFM69HW_OPMODE, value);
+    opMode = value & RFM69HW_OPMODE_MODE_MASK;
+    return waitFor(WaitModeReady, RFM69HW_IRQFLAGS1, RFM69HW_IRQFLAGS1_MODE_READY, true, MODE_READY_TIMEOUT_US);
+}
+
+void RFM69HW::armAutoTransmit(const bool armed) {
+    // AutoModes keys up as soon as anything lands in the FIFO, which in RX
+    // would send every received packet straight back out. It is disarmed
+    // whenever the receiver is started, and armed again from standby just
+    // before the FIFO is loaded.
+    if (autoTransmit)
+        write8(RFM69HW_AUTOMODES, armed ? AUTO_TRANSMIT : RFM69HW_AUTOMODES_ENTER_OFF);
+}
+
+void RFM69HW::setBoost(const bool on) {
+    const bool boost = on && highPower;
+    if (boost == boosted)
+        return;
+
+    write8(RFM69HW_TESTPA1, boost ? RFM69HW_TESTPA1_BOOST : RFM69HW_TESTPA1_NORMAL);
+    write8(RFM69HW_TESTPA2, boost ? RFM69HW_TESTPA2_BOOST : RFM69HW_TESTPA2_NORMAL);
+    boosted = boost;
+}
+
+bool RFM69HW::waitFor(const WaitId id, const uint8_t reg, const uint8_t mask, const bool set, const uint32_t timeout) {
+    // Poll the register until the masked bits are all set, or all clear,
+    // backing off between reads to leave the bus free
+    const uint32_t start = hal.micros();
+    bool done = ((read8(reg) & mask) == (set ? mask : 0));
+    while (!done && hal.micros() - start < timeout) {
+        idle();
+        done = ((read8(reg) & mask) == (set ? mask : 0));
+    }
+
+    recordWait(id, hal.micros() - start);
+    return done;
+}
+
+bool RFM69HW::waitForFlag(const WaitId id, volatile bool& flag, const bool set, const uint32_t timeout) {
+    // The flag is set by the interrupt handler, so there is no bus traffic
+    // while waiting on it unless the radio is in a group. Then the handler is
+    // run from here, along with those of the other radios.
+    const uint32_t start = hal.micros();
+    while (flag != set && hal.micros() - start < timeout) {
+        if (group)
+            group->service();
+    }
+
+    recordWait(id, hal.micros() - start);
+    return flag == set;
+}
+
+bool RFM69HW::sendStaged() {
+    if (txStaged == 0)
+        return true;
+
+    if (!transmit(broadcastAddress, txStage, txStaged))
+        return false;
+
+    txStaged = 0;
+    return true;
+}
+
+void RFM69HW::flushIfIdle() {
+    // A timeout of zero leaves partly filled frames until flush() is called.
+    // This runs from available(), so the frame is only queued rather than
+    // waited on. It stays staged while the queue is full.
+    if (txStaged && flushTimeout && hal.millis() - txStageTime >= flushTimeout &&
+        enqueue(broadcastAddress, txStage, txStaged))
+        txStaged = 0;
+}
+
+void RFM69HW::idle() {
+    // Put the time spent waiting on this radio to use on the others in its
+    // group. Otherwise back off to leave the bus free.
+    if (group)
+        group->service();
+    else
+        hal.delayMicroseconds(WAIT_POLL_US);
+}
+
+bool RFM69HW::waitIdle() {
+    serviceTransmit();
+    if (!txActive)
+        return true;
+
+    // Allow for every queued packet to be sent. Each one is loaded from here
+    // as soon as the interrupt handler has flagged the previous one as sent.
+    const uint32_t timeout = (RFM69HW_TX_QUEUE_LENGTH + 1) * packetTimeout(RFM69HW_MAX_PAYLOAD);
+    const uint32_t start = hal.micros();
+    while (txActive && hal.micros() - start < timeout) {
+        if (group)
+            group->service();
+        serviceTransmit();
+    }
+
+    recordWait(WaitPacketSent, hal.micros() - start);
+    if (!txActive)
+        return true;
+
+    // The device stopped responding. Drop the queue so that the next
+    // transmission starts afresh.
+    while (txTail != txHead) {
+        release(txQueue[txTail & TX_QUEUE_MASK]);
+        txTail = txTail + 1;
+    }
+
+    txActive = false;
+    return false;
+}
+
+void RFM69HW::recordWait(const WaitId id, const uint32_t elapsed) {
+#if RFM69HW_INSTRUMENTATION
+    if (elapsed > waits[id])
+        waits[id] = elapsed;
+#else
+    (void)id;
+    (void)elapsed;
+#endif
+}
+
+uint32_t RFM69HW::airTime(const size_t size) {
+    return (size + PACKET_OVERHEAD) * byteTime();
+}
+
+uint32_t RFM69HW::byteTime() {
+    // Microseconds it takes to send one byte at the current bit rate
+    return 8 * MILLION / bitrate + 1;
+}
+
+uint32_t RFM69HW::packetTimeout(const size_t size) {
+    // Twice the airtime of the packet, plus time for the TX start procedure
+    return 2 * airTime(size) + TX_MARGIN_US;
+}
+
+bool RFM69HW::enterListen() {
+    // Listen mode has to be entered from standby. The MCU is only woken by
+    // DIO0 when a packet is ready in the FIFO.
+    if (!standby())
+        return false;
+
+    armAutoTransmit(false);
+    write8(RFM69HW_DIOMAPPING1, RFM69HW_DIOMAPPING1_DIO0_01);
+    write8(RFM69HW_OPMODE, RFM69HW_OPMODE_LISTEN_ON | RFM69HW_OPMODE_MODE_STANDBY);
+    listening = true;
+    return true;
+}
+
+uint8_t RFM69HW::currentMode() {
+    if (listening)
+        return RFM69HW_OPMODE_LISTEN_ON;
+
+    return opMode;
+}
+
+void RFM69HW::restoreMode(const uint8_t mode) {
+    if (mode & RFM69HW_OPMODE_LISTEN_ON) {
+        // The listen timers are still programmed
+        enterListen();
+    } else if (mode == RFM69HW_OPMODE_MODE_RX) {
+        receive();
+    } else {
+        standby();
+    }
+}
+
+uint8_t RFM69HW::read8(const uint8_t reg) {
+#if RFM69HW_SHADOW_REGISTERS
+    if (isShadowed(reg))
+        return shadow[reg - SHADOW_FIRST];
+#endif
+
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(reg);
+    return guard.transfer(0x00);
+}
+
+uint16_t RFM69HW::read16(const uint8_t reg) {
+    uint8_t buffer[2];
+    readBurst(reg, buffer, sizeof(buffer));
+    return ((uint16_t)buffer[0] << 8) | buffer[1];
+}
+
+uint32_t RFM69HW::read24(const uint8_t reg) {
+    uint8_t buffer[3];
+    readBurst(reg, buffer, sizeof(buffer));
+    return ((uint32_t)buffer[0] << 16) | ((uint32_t)buffer[1] << 8) | buffer[2];
+}
+
+void RFM69HW::readBurst(const uint8_t reg, uint8_t* buffer, const size_t size) {
+#if RFM69HW_SHADOW_REGISTERS
+    if (isShadowed(reg, size)) {
+        memcpy(buffer, &shadow[reg - SHADOW_FIRST], size);
+        return;
+    }
+#endif
+
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(reg);
+    guard.receive(buffer, size);
+}
+
+void RFM69HW::write8(const uint8_t reg, const uint8_t value) {
+#if RFM69HW_SHADOW_REGISTERS
+    if (isShadowed(reg)) {
+        if (shadow[reg - SHADOW_FIRST] == value)
+            return;
+        shadow[reg - SHADOW_FIRST] = value;
+    }
+#endif
+
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(reg | 0x80);
+    guard.transfer(value);
+}
+
+void RFM69HW::writeTrigger(const uint8_t reg, const uint8_t bits) {
+    // Trigger bits clear themselves on the device. They go straight to it,
+    // so that the register shadow never holds them. Otherwise the next write
+    // of the same value would be skipped.
+    const uint8_t value = read8(reg) | bits;
+
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(reg | 0x80);
+    guard.transfer(value);
+}
+
+void RFM69HW::write16(const uint8_t reg, const uint16_t value) {
+    const uint8_t buffer[2] = {
+        (uint8_t)((value & 0xFF00) >> 8),
+        (uint8_t)((value & 0x00FF)),
+    };
+    writeBurst(reg, buffer, sizeof(buffer));
+}
+
+void RFM69HW::write24(const uint8_t reg, const uint32_t value) {
+    const uint8_t buffer[3] = {
+        (uint8_t)((value & 0xFF0000) >> 16),
+        (uint8_t)((value & 0x00FF00) >> 8),
+        (uint8_t)((value & 0x0000FF)),
+    };
+    writeBurst(reg, buffer, sizeof(buffer));
+}
+
+void RFM69HW::writeBurst(const uint8_t reg, const uint8_t* buffer, const size_t size) {
+#if RFM69HW_SHADOW_REGISTERS
+    if (isShadowed(reg, size)) {
+        if (memcmp(&shadow[reg - SHADOW_FIRST], buffer, size) == 0)
+            return;
+        memcpy(&shadow[reg - SHADOW_FIRST], buffer, size);
+    }
+#endif
+
+    volatile SPIGuard guard(hal, slaveSelectPin);
+    guard.transfer(reg | 0x80);
+    guard.send(buffer, size);
 }
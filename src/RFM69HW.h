@@ -27,13 +27,181 @@ THE SOFTWARE.
 
 #include <Arduino.h>
 #include <stdint.h>
+#include "RFM69HW_hal.h"
+
+// Build options. These change the layout of the RFM69HW class, so the sketch
+// and the library have to be compiled with the same values. Set them as
+// compiler flags for the whole build, such as compiler.cpp.extra_flags in
+// platform.local.txt or build_flags in PlatformIO. Defining them in the
+// sketch before including the library only changes the sketch's idea of the
+// class, not the library's.
+
+// Number of packet buffers, shared by received packets and those waiting to
+// be sent by sendAsync(). Must be a power of two no larger than 128. Each
+// buffer costs RFM69HW_MAX_PAYLOAD + 4 bytes of RAM.
+#ifndef RFM69HW_PACKET_POOL_SIZE
+#define RFM69HW_PACKET_POOL_SIZE  (4)
+#endif
+
+// Number of packets which can be waiting to be sent by sendAsync(). Must be a
+// power of two. The packets themselves are held in the packet pool.
+#ifndef RFM69HW_TX_QUEUE_LENGTH
+#define RFM69HW_TX_QUEUE_LENGTH  (2)
+#endif
+
+// Keep a copy of the configuration registers in RAM. Reads of those registers
+// are then served without touching the bus, and writes which would not change
+// anything are skipped. Costs 79 bytes of RAM.
+#ifndef RFM69HW_SHADOW_REGISTERS
+#define RFM69HW_SHADOW_REGISTERS  (0)
+#endif
+
+// Count SPI transactions, bytes and bus time per public API call, and the
+// worst-case duration of each busy-wait. Compiles to nothing when disabled.
+#ifndef RFM69HW_INSTRUMENTATION
+#define RFM69HW_INSTRUMENTATION  (0)
+#endif
+
+// Number of radios which can be running at the same time, each with its own
+// DIO0 interrupt. At most 4.
+#ifndef RFM69HW_MAX_RADIOS
+#define RFM69HW_MAX_RADIOS  (4)
+#endif
+
+// Number of frequency offsets remembered by drift tracking, one per peer and
+// temperature band. Each entry costs 4 bytes of RAM.
+#ifndef RFM69HW_DRIFT_ENTRIES
+#define RFM69HW_DRIFT_ENTRIES  (8)
+#endif
+
+// Returned by readings such as the RSSI or the temperature when the device did
+// not respond in time
+#define RFM69HW_READING_FAILED  (INT8_MIN)
+
+// Handle which refers to no packet buffer
+#define RFM69HW_NO_PACKET  (0xFF)
+
+// Largest payload which fits in the FIFO alongside its length byte
+#define RFM69HW_MAX_PAYLOAD  (65)
+
+// Largest message, including the address byte, which the AES engine handles
+#define RFM69HW_MAX_AES_PAYLOAD  (64)
+
+// Size of the AES-128 key in bytes
+#define RFM69HW_AES_KEY_SIZE  (16)
+
+class RFM69HWGroup;
 
 class RFM69HW : public Stream {
 public:
-    RFM69HW(const int8_t interruptPin, const int8_t slaveSelectPin=SS, const int8_t resetPin=-1);
+    typedef void (*Callback)();
+    typedef uint8_t Handle;
+
+    struct Packet {
+        uint8_t address;
+        uint8_t size;
+        uint8_t data[RFM69HW_MAX_PAYLOAD];
+    };
+
+    enum WaitId {
+        WaitModeReady,
+        WaitPacketSent,
+        WaitFifoLevel,
+        WaitHop,
+        WaitRssi,
+        WaitTemperature,
+        WaitCalibration,
+        WaitChannelClear,
+        WaitCount,
+    };
+
+#if RFM69HW_INSTRUMENTATION
+    enum ProfileId {
+        ProfileWrite,
+        ProfileSendAsync,
+        ProfileInterrupt,
+        ProfileOpMode,
+        ProfileSetCarrierFrequency,
+        ProfileReceivedSignalStrength,
+        ProfileTemperature,
+        ProfileCalibrateOscillator,
+        ProfileConfiguration,
+        ProfileOther,
+        ProfileCount,
+    };
+
+    struct Profile {
+        uint32_t calls;
+        uint32_t transactions;
+        uint32_t bytes;
+        uint32_t busMicros;
+    };
+#endif
+
+    enum ListenCriteria {
+        ListenRssi,
+        ListenRssiAndSync,
+    };
+
+    enum Modem {
+        Modem1200,
+        Modem4800,
+        Modem9600,
+        Modem38400,
+        Modem100000,
+        Modem200000,
+        Modem300000,
+        ModemCount,
+    };
+
+    enum DataMode {
+        PacketMode,
+        ContinuousBitSync,
+        Continuous,
+    };
+
+    enum AutoEnter {
+        AutoEnterFifoNotEmpty,
+        AutoEnterFifoLevel,
+        AutoEnterCrcOk,
+        AutoEnterPayloadReady,
+        AutoEnterSyncAddress,
+        AutoEnterPacketSent,
+        AutoEnterFifoEmpty,
+    };
+
+    enum AutoExit {
+        AutoExitFifoEmpty,
+        AutoExitFifoLevelOrTimeout,
+        AutoExitCrcOkOrTimeout,
+        AutoExitPayloadReadyOrTimeout,
+        AutoExitSyncAddressOrTimeout,
+        AutoExitPacketSent,
+        AutoExitTimeout,
+    };
+
+    enum AutoMode {
+        AutoSleep,
+        AutoStandby,
+        AutoReceive,
+        AutoTransmit,
+    };
+
+    RFM69HW(const int8_t interruptPin, const int8_t slaveSelectPin=SS, const int8_t resetPin=-1,
+            RFM69HWHal& hal=RFM69HWArduino);
+    ~RFM69HW();
+
+    // Compile-time configuration, see RFM69HW_config.h
+    template<uint32_t Bps> struct Bitrate;
+    template<uint32_t Hz> struct Fdev;
+    template<uint32_t Hz> struct Frequency;
+    template<uint8_t Address, uint8_t Value> struct Register;
+    template<typename... Settings> struct Config;
 
     bool begin();
     bool begin(const uint32_t baudRate, const uint32_t frequency);
+    template<typename ConfigT> bool begin();
+    template<typename ConfigT> void configure();
     void reset();
 
     int available();
@@ -43,39 +211,295 @@ public:
     int read();
     size_t write(uint8_t value);
     size_t write(const uint8_t* buffer, size_t size);
+    void setFlushTimeout(const uint32_t timeout);
+
+    bool sendAsync(const uint8_t* buffer, size_t size);
+    size_t sendTo(const uint8_t address, const uint8_t* buffer, size_t size);
+    bool sendToAsync(const uint8_t address, const uint8_t* buffer, size_t size);
+    bool receive(Packet& packet);
+    size_t receiveStream(uint8_t* buffer, const size_t size, const uint32_t timeout);
+
+    Handle borrow();
+    Handle allocate();
+    Packet& packet(const Handle handle);
+    void release(const Handle handle);
+    bool sendAsync(const Handle handle);
+    uint32_t receiveTime(const Handle handle);
 
-    void standby();
-    void sleep();
+    bool transmitting();
+    void onTransmit(Callback callback);
+
+    bool standby();
+    bool sleep();
+    bool receive();
+
+    bool listen(const uint32_t idleTime, const uint32_t rxTime, const ListenCriteria criteria=ListenRssiAndSync);
+    size_t sendBurst(const uint8_t* buffer, size_t size, const uint32_t duration);
+
+    bool setDataMode(const DataMode mode);
+    bool startTransmit();
+
+    void setAutoModes(const AutoEnter enter, const AutoExit exit, const AutoMode mode);
+    void disableAutoModes();
+
+    void setAddress(const uint8_t node, const uint8_t broadcast=0xFF);
+    void disableAddressing();
+    void setSyncWord(const uint8_t* sync, const uint8_t size);
+
+    void setEncryptionKey(const uint8_t* key);
+    void disableEncryption();
 
     uint32_t baudRate();
     void setBaudRate(const uint32_t value);
+    uint32_t airTime(const size_t size);
+
+    bool setModem(const Modem modem);
+
+    int8_t transmitPower();
+    bool setTransmitPower(const int8_t dbm);
+    static int8_t sensitivity(const Modem modem);
 
     uint32_t carrierFrequency();
-    void setCarrierFrequency(const uint32_t value);
+    bool setCarrierFrequency(const uint32_t value);
 
     uint32_t carrierFrequencyMHz();
-    void setCarrierFrequencyMHz(const uint32_t value);
+    bool setCarrierFrequencyMHz(const uint32_t value);
+
+    bool setChannels(const uint32_t* frequencies, uint32_t* frf, const uint8_t count, const uint8_t seed=0);
+    bool hopTo(const uint8_t index);
+    bool hopNext();
+    uint8_t channel();
+
+    void setDriftTracking(const bool enabled);
+    int32_t frequencyOffset(const uint8_t address);
+    bool tuneTo(const uint8_t address);
+
+    bool setSniffing(const bool enabled);
+    bool sniff(Print& out);
 
     int8_t receivedSignalStrength();
+    size_t scan(const uint32_t* frequencies, const uint8_t count, int8_t* rssi);
+
+    bool setListenBeforeTalk(const int8_t threshold, const uint32_t timeout);
+    void disableListenBeforeTalk();
+    bool channelClear();
 
     uint8_t version();
     int8_t temperature();
-    void calibrateOscillator();
+    bool calibrateOscillator();
+
+    void resync();
+
+#if RFM69HW_INSTRUMENTATION
+    const Profile& profile(const ProfileId id);
+    uint32_t worstWait(const WaitId id);
+    void resetProfiles();
+#endif
 
 private:
-    void setOpMode(const uint8_t value);
+    // What the interrupt handler measured about a frame. Only the time is
+    // measured unless sniffing.
+    struct Capture {
+        uint32_t time;
+        int16_t offset;
+        int8_t rssi;
+        bool crcOk;
+        uint8_t dropped;
+    };
+
+    template<uint8_t N> static void isr();
+    void handleInterrupt(const uint32_t now);
+    uint8_t receivePayload(const Capture& capture);
+    void transmitNext();
+    void serviceTransmit();
+
+    size_t transmit(const uint8_t address, const uint8_t* buffer, size_t size);
+    bool enqueue(const uint8_t address, const uint8_t* buffer, size_t size);
+    bool enqueue(const Handle handle);
+    Handle claim();
+    bool nextReceived();
+    uint8_t maxPayload();
+
+    bool waitFor(const WaitId id, const uint8_t reg, const uint8_t mask, const bool set, const uint32_t timeout);
+    bool waitForFlag(const WaitId id, volatile bool& flag, const bool set, const uint32_t timeout);
+    bool waitIdle();
+    bool sendStaged();
+    void flushIfIdle();
+    void idle();
+    void recordWait(const WaitId id, const uint32_t elapsed);
+    uint32_t byteTime();
+    uint32_t packetTimeout(const size_t size);
+
+    void writeFifo(const uint8_t address, const uint8_t* buffer, const uint8_t size);
+    bool drainFifo(uint8_t* buffer, const size_t count);
+    bool setOpMode(const uint8_t value);
+    void armAutoTransmit(const bool armed);
+    void setBoost(const bool on);
+    bool enterListen();
+    uint8_t currentMode();
+    bool hop(const uint32_t frf);
+    void trackDrift(const uint8_t address, const int16_t measured);
+    int16_t driftOffset(const uint8_t address);
+    void writeModem(const uint32_t bitrate, const uint32_t fdev, const uint8_t rxBw, const uint8_t afcBw);
+    bool sampleRssi(uint8_t& value);
+    bool waitChannelClear();
+    void restoreMode(const uint8_t mode);
 
     uint8_t read8(const uint8_t reg);
     uint16_t read16(const uint8_t reg);
     uint32_t read24(const uint8_t reg);
+    void readBurst(const uint8_t reg, uint8_t* buffer, const size_t size);
 
     void write8(const uint8_t reg, const uint8_t value);
+    void writeTrigger(const uint8_t reg, const uint8_t bits);
     void write16(const uint8_t reg, const uint16_t value);
     void write24(const uint8_t reg, const uint32_t value);
+    void writeBurst(const uint8_t reg, const uint8_t* buffer, const size_t size);
+
+    RFM69HWHal& hal;
 
     const int8_t interruptPin;
     const int8_t slaveSelectPin;
     const int8_t resetPin;
+
+    static RFM69HW* instances[RFM69HW_MAX_RADIOS];
+
+    // Set while the radio belongs to a group. Its interrupts are then only
+    // recorded as pending, along with when they came in, and serviced by the
+    // group outside of the ISR.
+    RFM69HWGroup* group;
+    volatile uint8_t pendingEvent;
+    volatile uint32_t pendingTime;
+
+    volatile bool listening;
+    volatile uint8_t opMode;
+
+    bool addressing;
+    bool encrypting;
+    uint8_t broadcastAddress;
+
+    // Transmit power in dBm. Above +17 dBm the PA boost registers have to be
+    // switched in while in TX, and back out again for every other mode.
+    int8_t txPower;
+    bool highPower;
+    bool boosted;
+
+    // Bit rate in bits per second. Every timeout is worked out from it, so it
+    // is kept here rather than read back from a device which may have stopped
+    // answering.
+    uint32_t bitrate;
+
+    // Set while the radio is in one of the continuous data modes. The packet
+    // engine and the FIFO are not used then.
+    bool continuous;
+
+    // Set while AutoModes keys up the transmitter as soon as the FIFO is
+    // loaded and drops back to the main mode once the packet is sent
+    bool autoTransmit;
+
+    // Listen before talk. A timeout of zero disables it. The threshold is in
+    // the units of the RSSI value register.
+    uint32_t lbtTimeout;
+    uint8_t lbtThreshold;
+
+    // Packet buffers. A buffer belongs to whoever claimed it until it is
+    // released. The interrupt handler skips the buffer which allocate() is
+    // looking at, so neither side has to turn interrupts off.
+    Packet pool[RFM69HW_PACKET_POOL_SIZE];
+    volatile bool poolUsed[RFM69HW_PACKET_POOL_SIZE];
+    volatile Handle poolClaim;
+
+    // Single-producer/single-consumer queue of received packets. The head is
+    // only advanced by the interrupt handler and the tail is only advanced by
+    // the application. Both count up freely and wrap around. The packet being
+    // read as a stream has been taken off the queue already.
+    volatile uint8_t rxHead;
+    volatile uint8_t rxTail;
+    Handle rxQueue[RFM69HW_PACKET_POOL_SIZE];
+    Handle rxCurrent;
+    uint8_t rxOffset;
+
+    // Set while receiveStream() drains the FIFO itself. The interrupt handler
+    // leaves PayloadReady alone then.
+    volatile bool rxStreaming;
+
+    // Frames which were received but did not fit in the pool or the receive
+    // queue. Counts up freely and wraps around.
+    volatile uint8_t rxDropped;
+
+    // Promiscuous capture. Every frame is kept, including those which fail
+    // the CRC check.
+    volatile bool sniffing;
+    uint8_t sniffDropped;
+
+    // What the interrupt handler measured about the frame in each buffer
+    Capture captures[RFM69HW_PACKET_POOL_SIZE];
+
+    // Carrier frequency as set by the application, before any correction for
+    // the frequency offset of a peer
+    uint32_t carrierFrf;
+
+    // Carrier frequency the synthesizer is tuned to right now, which is where
+    // the AFC measures from
+    uint32_t tunedFrf;
+
+    // Frequency offsets of peers, in synthesizer steps, as measured by the AFC
+    // on their packets. Kept per temperature band of this radio, which is
+    // updated whenever temperature() is read.
+    struct Drift {
+        uint8_t address;
+        uint8_t band;
+        int16_t offset;
+    };
+
+    bool driftTracking;
+    uint8_t driftBand;
+    uint8_t driftCount;
+    uint8_t driftNext;
+    Drift drift[RFM69HW_DRIFT_ENTRIES];
+
+    // Channel plan for hopping. The table of FRF register words is owned by
+    // the caller. The hop sequence is index = (109 * index + increment) & mask.
+    const uint32_t* channels;
+    uint8_t channelCount;
+    uint8_t channelIndex;
+    uint8_t hopMask;
+    uint8_t hopIncrement;
+
+#if RFM69HW_INSTRUMENTATION
+    Profile profiles[ProfileCount];
+    uint32_t waits[WaitCount];
+#endif
+
+#if RFM69HW_SHADOW_REGISTERS
+    // Copy of registers 0x01 (OpMode) through 0x4F (Temp2)
+    uint8_t shadow[0x4F];
+#endif
+
+    // Bytes written through the Stream interface, collected into one frame.
+    // The frame goes out once it is full, on flush(), or once no more bytes
+    // have been written for the flush timeout in milliseconds.
+    uint8_t txStage[RFM69HW_MAX_PAYLOAD];
+    uint8_t txStaged;
+    uint32_t txStageTime;
+    uint32_t flushTimeout;
+
+    // Queue of packets waiting to be sent. The head is only advanced by
+    // sendAsync() and the tail is only advanced once the packet has been
+    // loaded into the FIFO, which also releases its buffer. Both count up
+    // freely and wrap around.
+    volatile uint8_t txHead;
+    volatile uint8_t txTail;
+    volatile bool txActive;
+    volatile bool packetSent;
+    uint8_t txReturnMode;
+    Callback txCallback;
+    Handle txQueue[RFM69HW_TX_QUEUE_LENGTH];
+
+    friend class RFM69HWGroup;
+    friend class RFM69HWTdma;
 };
 
+#include "RFM69HW_config.h"
+
 #endif // _RFM69HW_H_
@@ -0,0 +1,88 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "RFM69HWGroup.h"
+
+RFM69HWGroup::RFM69HWGroup() :
+    count(0),
+    servicing(false)
+{
+}
+
+bool RFM69HWGroup::add(RFM69HW& radio) {
+    if (count == RFM69HW_MAX_RADIOS || radio.group)
+        return false;
+
+    radios[count++] = &radio;
+    radio.group = this;
+
+    return true;
+}
+
+uint8_t RFM69HWGroup::size() {
+    return count;
+}
+
+RFM69HW& RFM69HWGroup::operator[](const uint8_t index) {
+    return *radios[index];
+}
+
+uint8_t RFM69HWGroup::service() {
+    // Handlers wait on their devices too, which lands back in here. Only the
+    // outermost call services anything.
+    if (servicing)
+        return 0;
+
+    servicing = true;
+
+    uint8_t serviced = 0;
+    for (;;) {
+        // Find the radio which has been waiting the longest. Event numbers
+        // wrap around, so they are compared by their difference.
+        RFM69HW* next = NULL;
+        uint8_t oldest = 0;
+        for (uint8_t i = 0; i < count; ++i) {
+            const uint8_t event = radios[i]->pendingEvent;
+            if (event && (!next || (int8_t)(event - oldest) < 0)) {
+                next = radios[i];
+                oldest = event;
+            }
+        }
+
+        if (!next)
+            break;
+
+        // Clear the event before handling it, so that an interrupt which
+        // comes in meanwhile is not lost
+        next->pendingEvent = 0;
+        next->handleInterrupt(next->pendingTime);
+        next->serviceTransmit();
+        ++serviced;
+    }
+
+    servicing = false;
+
+    return serviced;
+}
@@ -0,0 +1,53 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef _RFM69HWGROUP_H_
+#define _RFM69HWGROUP_H_
+
+#include <stdint.h>
+#include "RFM69HW.h"
+
+// Several radios sharing one SPI bus. The radios in a group no longer touch
+// the bus from their interrupt handlers. Their interrupts are queued up
+// instead and serviced by service() in the order they came in, either from
+// the main loop or whenever one of the radios is waiting on its device. One
+// radio's time on air is then spent on the FIFOs of the others.
+class RFM69HWGroup {
+public:
+    RFM69HWGroup();
+
+    bool add(RFM69HW& radio);
+    uint8_t size();
+    RFM69HW& operator[](const uint8_t index);
+
+    uint8_t service();
+
+private:
+    RFM69HW* radios[RFM69HW_MAX_RADIOS];
+    uint8_t count;
+    bool servicing;
+};
+
+#endif // _RFM69HWGROUP_H_
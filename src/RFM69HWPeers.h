@@ -0,0 +1,81 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+
+#ifndef _RFM69HWPEERS_H_
+#define _RFM69HWPEERS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fixed size table of per-peer state, shared by the link controllers. Once
+// the table is full the least recently heard from peer makes way for a new
+// one. Every lookup ages the other peers, so the oldest one is the peer which
+// has been heard from least recently.
+template<typename PeerT, uint8_t N>
+class RFM69HWPeers {
+public:
+    RFM69HWPeers() : count(0) {}
+
+    // Returns the state kept for the peer, which starts out as a copy of
+    // initial the first time the peer is looked up
+    PeerT& find(const uint8_t address, const PeerT& initial) {
+        Entry* oldest = NULL;
+        Entry* found = NULL;
+        for (uint8_t i = 0; i < count; ++i) {
+            Entry& entry = entries[i];
+            if (entry.address == address) {
+                found = &entry;
+                continue;
+            }
+
+            if (entry.age < UINT8_MAX)
+                ++entry.age;
+            if (!oldest || entry.age > oldest->age)
+                oldest = &entry;
+        }
+
+        if (!found) {
+            found = count < N ? &entries[count++] : oldest;
+            found->address = address;
+            found->state = initial;
+        }
+
+        found->age = 0;
+        return found->state;
+    }
+
+private:
+    struct Entry {
+        uint8_t address;
+        uint8_t age;
+        PeerT state;
+    };
+
+    uint8_t count;
+    Entry entries[N];
+};
+
+#endif // _RFM69HWPEERS_H_
@@ -0,0 +1,98 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "RFM69HWPower.h"
+
+// RSSI above the target, in dB, tolerated before backing off. This keeps the
+// power from hunting up and down around the target.
+#define HYSTERESIS_DB  (3)
+
+// Largest steps taken in one go, in dB. Backing off is done more cautiously
+// than stepping up, as a lost packet costs more than a little extra power.
+#define STEP_DOWN_DB  (3)
+#define STEP_UP_DB  (6)
+
+// Step taken after a lost packet, in dB
+#define LOST_STEP_DB  (3)
+
+RFM69HWPower::RFM69HWPower(RFM69HW& radio, const int8_t minimum, const int8_t maximum, const int8_t target) :
+    radio(radio),
+    minimum(minimum),
+    maximum(maximum),
+    target(target),
+    active(INT8_MIN)
+{
+}
+
+int8_t RFM69HWPower::power(const uint8_t address) {
+    return find(address).power;
+}
+
+bool RFM69HWPower::select(const uint8_t address) {
+    // Only touch the radio when the power actually changes
+    const int8_t next = power(address);
+    if (next == active)
+        return true;
+
+    if (!radio.setTransmitPower(next))
+        return false;
+
+    active = next;
+    return true;
+}
+
+void RFM69HWPower::acknowledged(const uint8_t address, const int8_t rssi) {
+    if (rssi == RFM69HW_READING_FAILED)
+        return;
+
+    // Back off by half of the excess, so a single strong reading does not
+    // take the link down to the edge
+    Peer& peer = find(address);
+    const int16_t error = rssi - target;
+    if (error > HYSTERESIS_DB)
+        adjust(peer, -(int8_t)(error / 2 < STEP_DOWN_DB ? error / 2 : STEP_DOWN_DB));
+    else if (error < 0)
+        adjust(peer, (int8_t)(-error < STEP_UP_DB ? -error : STEP_UP_DB));
+}
+
+void RFM69HWPower::lost(const uint8_t address) {
+    adjust(find(address), LOST_STEP_DB);
+}
+
+void RFM69HWPower::adjust(Peer& peer, const int8_t step) {
+    const int16_t power = peer.power + step;
+    if (power < minimum)
+        peer.power = minimum;
+    else if (power > maximum)
+        peer.power = maximum;
+    else
+        peer.power = power;
+}
+
+RFM69HWPower::Peer& RFM69HWPower::find(const uint8_t address) {
+    // New peers start out at full power, so the first packets get through
+    const Peer initial = { maximum };
+    return peers.find(address, initial);
+}
@@ -0,0 +1,74 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef _RFM69HWPOWER_H_
+#define _RFM69HWPOWER_H_
+
+#include <stdint.h>
+#include "RFM69HW.h"
+#include "RFM69HWPeers.h"
+
+// Number of peers whose transmit power is tracked. A build option, see
+// RFM69HW.h.
+#ifndef RFM69HW_POWER_PEERS
+#define RFM69HW_POWER_PEERS  (8)
+#endif
+
+// Automatic transmit power control. Keeps a transmit power per peer, backing
+// off while the peer hears us well above the target RSSI and stepping back up
+// when it falls below the target or packets are lost.
+//
+// The RSSI passed to acknowledged() is how strongly the peer heard us, which
+// the peer has to report back, for example in its acknowledgement. With both
+// ends running the same power the RSSI of the acknowledgement itself is a fair
+// stand in.
+class RFM69HWPower {
+public:
+    RFM69HWPower(RFM69HW& radio, const int8_t minimum=-2, const int8_t maximum=20,
+                 const int8_t target=-80);
+
+    int8_t power(const uint8_t address);
+    bool select(const uint8_t address);
+
+    void acknowledged(const uint8_t address, const int8_t rssi);
+    void lost(const uint8_t address);
+
+private:
+    struct Peer {
+        int8_t power;
+    };
+
+    Peer& find(const uint8_t address);
+    void adjust(Peer& peer, const int8_t step);
+
+    RFM69HW& radio;
+    const int8_t minimum;
+    const int8_t maximum;
+    const int8_t target;
+    int8_t active;
+    RFM69HWPeers<Peer, RFM69HW_POWER_PEERS> peers;
+};
+
+#endif // _RFM69HWPOWER_H_
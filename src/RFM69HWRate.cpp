@@ -0,0 +1,110 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "RFM69HWRate.h"
+
+// Packets in a row which have to get through before trying a faster profile
+#define STEP_UP_SUCCESSES  (8)
+
+// Packets in a row which have to fail before falling back to a slower one
+#define STEP_DOWN_FAILURES  (2)
+
+// RSSI above the sensitivity of a profile, in dB, needed to move up to it.
+// Falling below half of this on the current profile moves down.
+#define LINK_MARGIN_DB  (10)
+
+RFM69HWRate::RFM69HWRate(RFM69HW& radio, const RFM69HW::Modem slowest, const RFM69HW::Modem fastest) :
+    radio(radio),
+    slowest(slowest),
+    fastest(fastest),
+    active(RFM69HW::ModemCount)
+{
+}
+
+RFM69HW::Modem RFM69HWRate::modem(const uint8_t address) {
+    return (RFM69HW::Modem)find(address).modem;
+}
+
+bool RFM69HWRate::select(const uint8_t address) {
+    // Only touch the radio when the profile actually changes
+    const RFM69HW::Modem next = modem(address);
+    if (next == active)
+        return true;
+
+    if (!radio.setModem(next))
+        return false;
+
+    active = next;
+    return true;
+}
+
+void RFM69HWRate::success(const uint8_t address, const int8_t rssi) {
+    if (rssi == RFM69HW_READING_FAILED)
+        return;
+
+    Peer& peer = find(address);
+    peer.failures = 0;
+
+    // Smooth the RSSI over the last few packets
+    if (peer.rssi == RFM69HW_READING_FAILED)
+        peer.rssi = rssi;
+    else
+        peer.rssi = (3 * peer.rssi + rssi) / 4;
+
+    const RFM69HW::Modem current = (RFM69HW::Modem)peer.modem;
+    if (current > slowest && peer.rssi < RFM69HW::sensitivity(current) + LINK_MARGIN_DB / 2) {
+        --peer.modem;
+        peer.successes = 0;
+        return;
+    }
+
+    if (++peer.successes < STEP_UP_SUCCESSES)
+        return;
+
+    const RFM69HW::Modem faster = (RFM69HW::Modem)(current + 1);
+    if (current < fastest && peer.rssi >= RFM69HW::sensitivity(faster) + LINK_MARGIN_DB)
+        ++peer.modem;
+
+    peer.successes = 0;
+}
+
+void RFM69HWRate::failure(const uint8_t address) {
+    Peer& peer = find(address);
+    peer.successes = 0;
+
+    if (++peer.failures < STEP_DOWN_FAILURES)
+        return;
+
+    if (peer.modem > slowest)
+        --peer.modem;
+
+    peer.failures = 0;
+}
+
+RFM69HWRate::Peer& RFM69HWRate::find(const uint8_t address) {
+    // New peers start out on the slowest, most robust profile
+    const Peer initial = { (uint8_t)slowest, 0, 0, RFM69HW_READING_FAILED };
+    return peers.find(address, initial);
+}
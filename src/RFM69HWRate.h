@@ -0,0 +1,74 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef _RFM69HWRATE_H_
+#define _RFM69HWRATE_H_
+
+#include <stdint.h>
+#include "RFM69HW.h"
+#include "RFM69HWPeers.h"
+
+// Number of peers whose link quality is tracked. A build option, see
+// RFM69HW.h.
+#ifndef RFM69HW_RATE_PEERS
+#define RFM69HW_RATE_PEERS  (8)
+#endif
+
+// Adaptive data rate. Keeps a modem profile per peer, stepping up to faster
+// profiles while packets keep getting through with RSSI to spare, and back
+// down when they start to fail or the RSSI nears the sensitivity limit.
+//
+// Both ends of a link have to use the same profile. The controller only
+// decides; the application tells the peer about a change, for example in
+// its acknowledgement, before calling select() with the new profile.
+class RFM69HWRate {
+public:
+    RFM69HWRate(RFM69HW& radio, const RFM69HW::Modem slowest=RFM69HW::Modem4800,
+                const RFM69HW::Modem fastest=RFM69HW::Modem300000);
+
+    RFM69HW::Modem modem(const uint8_t address);
+    bool select(const uint8_t address);
+
+    void success(const uint8_t address, const int8_t rssi);
+    void failure(const uint8_t address);
+
+private:
+    struct Peer {
+        uint8_t modem;
+        uint8_t successes;
+        uint8_t failures;
+        int8_t rssi;
+    };
+
+    Peer& find(const uint8_t address);
+
+    RFM69HW& radio;
+    const RFM69HW::Modem slowest;
+    const RFM69HW::Modem fastest;
+    RFM69HW::Modem active;
+    RFM69HWPeers<Peer, RFM69HW_RATE_PEERS> peers;
+};
+
+#endif // _RFM69HWRATE_H_
@@ -0,0 +1,295 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include <string.h>
+#include "RFM69HWTdma.h"
+
+#define MILLION  (1000000)
+
+// A beacon is the marker, the frame sequence number, the number of slots and
+// the largest payload a slot has room for. It goes to the broadcast address
+// the gateway's radio was given by setAddress(), which the whole cell shares.
+#define BEACON_MARKER  (0xBE)
+#define BEACON_SIZE  (4)
+
+// Fixed part of the guard time, in microseconds, for interrupt latency and
+// the mode changes around a slot. A few bytes at the current bit rate are
+// added on top, for the timestamp of the beacon.
+#define GUARD_US  (500)
+#define GUARD_BYTES  (4)
+
+// Clock difference between the gateway and a node left over once the frame
+// length has been measured, in parts per million
+#define DRIFT_PPM  (100)
+
+// Beacons a node may miss in a row before it drops out of step and listens
+// continuously again
+#define MAX_MISSED  (4)
+
+// Time it takes the radio to come up from sleep, in microseconds
+#define WAKE_US  (2000)
+
+// The frame length measured by a node is smoothed over the last few frames.
+// Measurements which are further off than 1/64 of a frame are ignored.
+#define DISCIPLINE_SMOOTHING  (4)
+#define DISCIPLINE_LIMIT  (64)
+
+RFM69HWTdma::RFM69HWTdma(RFM69HW& radio) :
+    radio(radio),
+    gateway(false),
+    synced(false),
+    disciplined(false),
+    awake(false),
+    receiving(false),
+    sent(false),
+    slot(0),
+    address(0),
+    sequence(0),
+    missed(0),
+    queued(RFM69HW_NO_PACKET),
+    slots(0),
+    payload(0),
+    slotTime(0),
+    guard(0),
+    frameStart(0),
+    period(0),
+    lastBeacon(0)
+{
+}
+
+bool RFM69HWTdma::beginGateway(const uint8_t slots, const uint8_t payload) {
+    if (slots == 0 || payload > RFM69HW_MAX_PAYLOAD)
+        return false;
+
+    gateway = true;
+    synced = true;
+    configure(slots, payload);
+
+    // Send the first beacon right away, and receive in between beacons
+    frameStart = radio.hal.micros() - period;
+    awake = true;
+    receiving = true;
+    return radio.receive();
+}
+
+bool RFM69HWTdma::beginNode(const uint8_t slot, const uint8_t address) {
+    gateway = false;
+    synced = false;
+    disciplined = false;
+    this->slot = slot;
+    this->address = address;
+
+    // Listen continuously until the first beacon is heard
+    awake = true;
+    receiving = true;
+    return radio.receive();
+}
+
+bool RFM69HWTdma::synchronized() {
+    return synced;
+}
+
+bool RFM69HWTdma::send(const uint8_t* buffer, const size_t size) {
+    // One packet per frame, which waits in the pool for the slot
+    if (gateway || !synced || queued != RFM69HW_NO_PACKET || size > payload)
+        return false;
+
+    const RFM69HW::Handle handle = radio.allocate();
+    if (handle == RFM69HW_NO_PACKET)
+        return false;
+
+    RFM69HW::Packet& packet = radio.packet(handle);
+    packet.address = address;
+    packet.size = size;
+    memcpy(packet.data, buffer, size);
+    queued = handle;
+    return true;
+}
+
+bool RFM69HWTdma::pending() {
+    return queued != RFM69HW_NO_PACKET;
+}
+
+void RFM69HWTdma::service() {
+    if (gateway)
+        serviceGateway();
+    else
+        serviceNode();
+}
+
+void RFM69HWTdma::serviceGateway() {
+    const uint32_t now = radio.hal.micros();
+    if ((int32_t)(now - frameStart) < (int32_t)period)
+        return;
+
+    // Keep the frames back to back, unless service() was held up for longer
+    // than a whole frame. Nodes line up with the beacon as it was actually
+    // received, so a late beacon only shifts the frame.
+    frameStart += period;
+    if ((int32_t)(now - frameStart) >= (int32_t)period)
+        frameStart = now;
+
+    ++sequence;
+    const uint8_t data[BEACON_SIZE] = { BEACON_MARKER, sequence, slots, payload };
+    radio.sendTo(radio.broadcastAddress, data, sizeof(data));
+}
+
+void RFM69HWTdma::serviceNode() {
+    receiveBeacons();
+
+    // Until in step with the gateway, listen continuously for its beacons
+    if (!synced)
+        return;
+
+    const uint32_t now = radio.hal.micros();
+
+    // Transmit a guard time into our own slot. The slot can only be trusted
+    // once the frame length has been measured.
+    if (queued != RFM69HW_NO_PACKET && !sent && disciplined) {
+        const uint32_t at = frameStart + (uint32_t)(slot + 1) * slotTime + guard;
+        const int32_t wait = at - now;
+        if (wait < -(int32_t)guard) {
+            // Too late for this frame. The packet waits for the next one.
+            sent = true;
+        } else if (wait <= WAKE_US) {
+            radio.standby();
+            awake = true;
+            receiving = false;
+            while ((int32_t)(radio.hal.micros() - at) < 0)
+                ;
+
+            if (radio.sendAsync(queued))
+                queued = RFM69HW_NO_PACKET;
+            sent = true;
+            return;
+        }
+    }
+
+    // Listen for the next beacon from a guard time before it is due until a
+    // guard time after it should have been received. The guard widens with
+    // every beacon missed in a row.
+    const uint32_t next = frameStart + period;
+    const uint32_t window = guardTime(missed + 1);
+    if ((int32_t)(now - (next - window - WAKE_US)) >= 0) {
+        if ((int32_t)(now - (next + radio.airTime(BEACON_SIZE) + window)) < 0) {
+            if (!receiving && !radio.transmitting()) {
+                radio.receive();
+                awake = true;
+                receiving = true;
+            }
+            return;
+        }
+
+        // Missed it. Carry on with the frame where it should have started.
+        frameStart = next;
+        sent = false;
+        if (++missed > MAX_MISSED) {
+            synced = false;
+            if (!receiving) {
+                radio.receive();
+                awake = true;
+                receiving = true;
+            }
+            return;
+        }
+    }
+
+    rest();
+}
+
+void RFM69HWTdma::receiveBeacons() {
+    for (;;) {
+        const RFM69HW::Handle handle = radio.borrow();
+        if (handle == RFM69HW_NO_PACKET)
+            return;
+
+        const RFM69HW::Packet& packet = radio.packet(handle);
+        if (packet.size == BEACON_SIZE && packet.data[0] == BEACON_MARKER)
+            beacon(packet.data, radio.receiveTime(handle));
+
+        radio.release(handle);
+    }
+}
+
+void RFM69HWTdma::beacon(const uint8_t* data, const uint32_t time) {
+    // The interrupt handler timestamps the end of the beacon. The frame
+    // starts where the gateway started sending it.
+    const uint32_t start = time - radio.airTime(BEACON_SIZE);
+
+    // Start over if the gateway changed the frame layout
+    if (data[2] != slots || data[3] != payload) {
+        configure(data[2], data[3]);
+        synced = false;
+        disciplined = false;
+    }
+
+    // Measure the frame length against our own clock, over however many
+    // frames it has been since the last beacon heard
+    const uint8_t frames = data[1] - sequence;
+    if (synced && frames > 0) {
+        const int32_t error = (start - lastBeacon) / frames - period;
+        const int32_t limit = period / DISCIPLINE_LIMIT;
+        if (error > -limit && error < limit) {
+            period = disciplined ? period + error / DISCIPLINE_SMOOTHING : period + error;
+            disciplined = true;
+        }
+    }
+
+    sequence = data[1];
+    lastBeacon = start;
+    frameStart = start;
+    missed = 0;
+    sent = false;
+    synced = true;
+}
+
+void RFM69HWTdma::configure(const uint8_t slots, const uint8_t payload) {
+    this->slots = slots;
+    this->payload = payload;
+
+    // A slot holds the largest packet with a guard time either side. The
+    // guard has to cover the drift over the frames a node may go without a
+    // beacon, which depends on the frame length in turn, so it is worked out
+    // from the frame length without any drift first.
+    const uint32_t air = radio.airTime(payload);
+    period = (slots + 1) * (air + 2 * guardTime(0));
+    guard = guardTime(MAX_MISSED + 1);
+    slotTime = air + 2 * guard;
+    period = (slots + 1) * slotTime;
+}
+
+uint32_t RFM69HWTdma::guardTime(const uint8_t frames) {
+    return GUARD_US + GUARD_BYTES * radio.byteTime() + frames * (period / (MILLION / DRIFT_PPM));
+}
+
+void RFM69HWTdma::rest() {
+    // Sleep until the next slot or beacon, once the packet is out
+    if (!awake || radio.transmitting())
+        return;
+
+    radio.sleep();
+    awake = false;
+    receiving = false;
+}
@@ -0,0 +1,93 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef _RFM69HWTDMA_H_
+#define _RFM69HWTDMA_H_
+
+#include <stdint.h>
+#include "RFM69HW.h"
+
+// Time division multiple access for a cell of nodes around one gateway. The
+// gateway sends a beacon at the start of every frame, and the rest of the
+// frame is split into one slot per node. A node keeps its clock in step with
+// the beacons, as timestamped by its interrupt handler, and only transmits in
+// its own slot. In between it puts the radio to sleep, waking up for its slot
+// and for the next beacon.
+//
+// The gateway receives the packets of the nodes as usual, through receive()
+// or borrow() on the radio. Nodes only listen for beacons; anything else they
+// receive is dropped. service() has to be called often, from the main loop,
+// on both sides.
+class RFM69HWTdma {
+public:
+    RFM69HWTdma(RFM69HW& radio);
+
+    bool beginGateway(const uint8_t slots, const uint8_t payload=RFM69HW_MAX_PAYLOAD);
+    bool beginNode(const uint8_t slot, const uint8_t address);
+
+    bool synchronized();
+    bool send(const uint8_t* buffer, const size_t size);
+    bool pending();
+
+    void service();
+
+private:
+    void serviceGateway();
+    void serviceNode();
+    void receiveBeacons();
+    void beacon(const uint8_t* data, const uint32_t time);
+    void configure(const uint8_t slots, const uint8_t payload);
+    uint32_t guardTime(const uint8_t frames);
+    void rest();
+
+    RFM69HW& radio;
+
+    bool gateway;
+    bool synced;
+    bool disciplined;
+    bool awake;
+    bool receiving;
+    bool sent;
+    uint8_t slot;
+    uint8_t address;
+    uint8_t sequence;
+    uint8_t missed;
+    RFM69HW::Handle queued;
+
+    // Frame layout, as set up by the gateway and announced in its beacons
+    uint8_t slots;
+    uint8_t payload;
+    uint32_t slotTime;
+    uint32_t guard;
+
+    // Start of the current frame and the length of a frame, both in local
+    // microseconds. On a node the length is disciplined to the beacons, which
+    // takes out the difference between the two clocks.
+    uint32_t frameStart;
+    uint32_t period;
+    uint32_t lastBeacon;
+};
+
+#endif // _RFM69HWTDMA_H_
@@ -0,0 +1,160 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef _RFM69HW_CONFIG_H_
+#define _RFM69HW_CONFIG_H_
+
+#include "RFM69HW_registers.h"
+
+// Compile-time radio configuration. Each setting describes a run of
+// consecutive registers whose values are worked out by the compiler, and a
+// Config applies a list of them with one SPI burst per setting:
+//
+//   typedef RFM69HW::Config<
+//       RFM69HW::Bitrate<38400>,
+//       RFM69HW::Fdev<40000>,
+//       RFM69HW::Frequency<915000000>
+//   > RadioConfig;
+//
+//   radio.begin<RadioConfig>();
+//
+// Settings which the device cannot support fail to compile.
+
+#define RFM69HW_CONFIG_FXOSC_HZ  (32000000UL)
+
+// Bit rate in bits per second
+template<uint32_t Bps>
+struct RFM69HW::Bitrate {
+    static_assert(Bps >= 1200 && Bps <= 300000,
+                  "Bitrate must be between 1.2 and 300 kbps");
+
+    static const uint8_t address = RFM69HW_BITRATEMSB;
+    static const uint8_t size = 2;
+    static const uint32_t value = (RFM69HW_CONFIG_FXOSC_HZ + Bps / 2) / Bps;
+    static const uint32_t bitrate = Bps;
+    static const uint32_t fdev = 0;
+};
+
+// Frequency deviation in Hz. The register is in steps of FXOSC / 2^19.
+template<uint32_t Hz>
+struct RFM69HW::Fdev {
+    static_assert(Hz >= 600 && Hz <= 300000,
+                  "Frequency deviation must be between 600 Hz and 300 kHz");
+
+    static const uint8_t address = RFM69HW_FDEVMSB;
+    static const uint8_t size = 2;
+    static const uint32_t value = (((uint64_t)Hz << 19) + RFM69HW_CONFIG_FXOSC_HZ / 2) / RFM69HW_CONFIG_FXOSC_HZ;
+    static const uint32_t bitrate = 0;
+    static const uint32_t fdev = Hz;
+};
+
+// Carrier frequency in Hz. The register is in steps of FXOSC / 2^19.
+template<uint32_t Hz>
+struct RFM69HW::Frequency {
+    static_assert((Hz >= 290000000UL && Hz <= 340000000UL) ||
+                  (Hz >= 424000000UL && Hz <= 510000000UL) ||
+                  (Hz >= 862000000UL && Hz <= 1020000000UL),
+                  "Frequency must be within one of the 315, 433, 868 or 915 MHz bands");
+
+    static const uint8_t address = RFM69HW_FRFMSB;
+    static const uint8_t size = 3;
+    static const uint32_t value = (((uint64_t)Hz << 19) + RFM69HW_CONFIG_FXOSC_HZ / 2) / RFM69HW_CONFIG_FXOSC_HZ;
+    static const uint32_t bitrate = 0;
+    static const uint32_t fdev = 0;
+};
+
+// Raw value for any single register not covered by the settings above
+template<uint8_t Address, uint8_t Value>
+struct RFM69HW::Register {
+    static_assert(Address > RFM69HW_FIFO && Address <= RFM69HW_TESTAFC,
+                  "Register address out of range");
+
+    static const uint8_t address = Address;
+    static const uint8_t size = 1;
+    static const uint32_t value = Value;
+    static const uint32_t bitrate = 0;
+    static const uint32_t fdev = 0;
+};
+
+template<typename... Settings>
+struct RFM69HW::Config {
+private:
+    static constexpr uint32_t sum() {
+        return 0;
+    }
+
+    template<typename... Values>
+    static constexpr uint32_t sum(const uint32_t first, const Values... rest) {
+        return first + sum(rest...);
+    }
+
+    template<typename Setting>
+    static void write(RFM69HW& radio) {
+        uint8_t data[Setting::size];
+        for (uint8_t i = 0; i < Setting::size; ++i)
+            data[i] = Setting::value >> (8 * (Setting::size - 1 - i));
+        radio.writeBurst(Setting::address, data, Setting::size);
+    }
+
+public:
+    static const uint32_t bitrate = sum(Settings::bitrate...);
+    static const uint32_t fdev = sum(Settings::fdev...);
+
+    // Checks between settings only apply when both of them are given. The
+    // modulation index is 2 * Fdev / Bitrate.
+    static_assert(bitrate == 0 || fdev == 0 || fdev + bitrate / 2 <= 500000,
+                  "Fdev + Bitrate / 2 must not exceed 500 kHz");
+    static_assert(bitrate == 0 || fdev == 0 || 4 * fdev >= bitrate,
+                  "Modulation index must be at least 0.5");
+    static_assert(bitrate == 0 || fdev == 0 || fdev <= 5 * bitrate,
+                  "Modulation index must be at most 10");
+
+    static void apply(RFM69HW& radio) {
+        const int expand[] = { 0, (write<Settings>(radio), 0)... };
+        (void)expand;
+    }
+};
+
+template<typename ConfigT>
+bool RFM69HW::begin() {
+    if (!begin())
+        return false;
+
+    configure<ConfigT>();
+    return true;
+}
+
+template<typename ConfigT>
+void RFM69HW::configure() {
+    ConfigT::apply(*this);
+
+    // The carrier frequency and bit rate may have been part of the
+    // configuration
+    carrierFrf = tunedFrf = read24(RFM69HW_FRFMSB);
+    if (ConfigT::bitrate)
+        bitrate = ConfigT::bitrate;
+}
+
+#endif // _RFM69HW_CONFIG_H_
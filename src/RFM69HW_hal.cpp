@@ -0,0 +1,119 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "RFM69HW_hal.h"
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#define SPI_SPEED_HZ  (10000000)
+
+RFM69HWArduinoHal RFM69HWArduino;
+
+void RFM69HWArduinoHal::spiBegin() {
+    SPI.begin();
+}
+
+void RFM69HWArduinoHal::spiUsingInterrupt(const int8_t pin) {
+    // Keeps the interrupt handler from running in the middle of one of our
+    // own SPI transactions
+    SPI.usingInterrupt(digitalPinToInterrupt(pin));
+}
+
+void RFM69HWArduinoHal::spiSelect(const int8_t slaveSelectPin) {
+    SPI.beginTransaction(SPISettings(SPI_SPEED_HZ, MSBFIRST, SPI_MODE0));
+    ::digitalWrite(slaveSelectPin, LOW);
+}
+
+void RFM69HWArduinoHal::spiDeselect(const int8_t slaveSelectPin) {
+    ::digitalWrite(slaveSelectPin, HIGH);
+    SPI.endTransaction();
+}
+
+uint8_t RFM69HWArduinoHal::spiTransfer(const uint8_t value) {
+    return SPI.transfer(value);
+}
+
+void RFM69HWArduinoHal::spiSend(const uint8_t* buffer, size_t size) {
+#if defined(ARDUINO_ARCH_ESP32)
+    SPI.writeBytes(buffer, size);
+#elif defined(RFM69HW_SPI_DMA)
+    // Cores such as the Adafruit SAMD core provide a DMA backed transfer
+    SPI.transfer(buffer, NULL, size, true);
+#else
+    // The generic buffer transfer overwrites its argument with the received
+    // data, so stage the payload through a small scratch buffer.
+    uint8_t scratch[16];
+    while (size > 0) {
+        const size_t count = size < sizeof(scratch) ? size : sizeof(scratch);
+        memcpy(scratch, buffer, count);
+        SPI.transfer(scratch, count);
+        buffer += count;
+        size -= count;
+    }
+#endif
+}
+
+void RFM69HWArduinoHal::spiReceive(uint8_t* buffer, size_t size) {
+#if defined(RFM69HW_SPI_DMA)
+    SPI.transfer(NULL, buffer, size, true);
+#else
+    // The bytes sent while reading are ignored by the device, so the buffer
+    // can be transferred in place.
+    SPI.transfer(buffer, size);
+#endif
+}
+
+void RFM69HWArduinoHal::pinOutput(const int8_t pin, const bool high) {
+    ::pinMode(pin, OUTPUT);
+    ::digitalWrite(pin, high ? HIGH : LOW);
+}
+
+void RFM69HWArduinoHal::pinInput(const int8_t pin) {
+    ::pinMode(pin, INPUT);
+}
+
+void RFM69HWArduinoHal::pinWrite(const int8_t pin, const bool high) {
+    ::digitalWrite(pin, high ? HIGH : LOW);
+}
+
+void RFM69HWArduinoHal::attachInterrupt(const int8_t pin, void (*handler)()) {
+    ::attachInterrupt(digitalPinToInterrupt(pin), handler, RISING);
+}
+
+void RFM69HWArduinoHal::delay(const uint32_t ms) {
+    ::delay(ms);
+}
+
+void RFM69HWArduinoHal::delayMicroseconds(const uint32_t us) {
+    ::delayMicroseconds(us);
+}
+
+uint32_t RFM69HWArduinoHal::millis() {
+    return ::millis();
+}
+
+uint32_t RFM69HWArduinoHal::micros() {
+    return ::micros();
+}
@@ -0,0 +1,91 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _RFM69HW_HAL_H_
+#define _RFM69HW_HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Everything the driver needs from the board: the SPI bus, GPIO, the DIO0
+// interrupt and a clock. The default implementation below uses the Arduino
+// core. Passing another implementation to the RFM69HW constructor lets the
+// driver run against anything which behaves like the device, such as a
+// register-level model of it on a desktop machine.
+class RFM69HWHal {
+public:
+    virtual void spiBegin() = 0;
+    virtual void spiUsingInterrupt(const int8_t pin) = 0;
+
+    // Start and end an SPI transaction with the slave select pin asserted
+    virtual void spiSelect(const int8_t slaveSelectPin) = 0;
+    virtual void spiDeselect(const int8_t slaveSelectPin) = 0;
+
+    virtual uint8_t spiTransfer(const uint8_t value) = 0;
+    virtual void spiSend(const uint8_t* buffer, size_t size) = 0;
+    virtual void spiReceive(uint8_t* buffer, size_t size) = 0;
+
+    virtual void pinOutput(const int8_t pin, const bool high) = 0;
+    virtual void pinInput(const int8_t pin) = 0;
+    virtual void pinWrite(const int8_t pin, const bool high) = 0;
+
+    // Call the handler on each rising edge of the pin
+    virtual void attachInterrupt(const int8_t pin, void (*handler)()) = 0;
+
+    virtual void delay(const uint32_t ms) = 0;
+    virtual void delayMicroseconds(const uint32_t us) = 0;
+    virtual uint32_t millis() = 0;
+    virtual uint32_t micros() = 0;
+
+protected:
+    ~RFM69HWHal() {}
+};
+
+class RFM69HWArduinoHal : public RFM69HWHal {
+public:
+    void spiBegin();
+    void spiUsingInterrupt(const int8_t pin);
+
+    void spiSelect(const int8_t slaveSelectPin);
+    void spiDeselect(const int8_t slaveSelectPin);
+
+    uint8_t spiTransfer(const uint8_t value);
+    void spiSend(const uint8_t* buffer, size_t size);
+    void spiReceive(uint8_t* buffer, size_t size);
+
+    void pinOutput(const int8_t pin, const bool high);
+    void pinInput(const int8_t pin);
+    void pinWrite(const int8_t pin, const bool high);
+
+    void attachInterrupt(const int8_t pin, void (*handler)());
+
+    void delay(const uint32_t ms);
+    void delayMicroseconds(const uint32_t us);
+    uint32_t millis();
+    uint32_t micros();
+};
+
+extern RFM69HWArduinoHal RFM69HWArduino;
+
+#endif // _RFM69HW_HAL_H_
@@ -125,14 +125,105 @@ THE SOFTWARE.
 #define RFM69HW_OPMODE_MODE_TX          (0b011 << 2)
 #define RFM69HW_OPMODE_MODE_RX          (0b100 << 2)
 
+// 0x02 - Data modulation masks
+#define RFM69HW_DATAMODUL_DATA_MODE_MASK                (0b11 << 5)
+#define RFM69HW_DATAMODUL_DATA_MODE_PACKET              (0b00 << 5) // Default
+#define RFM69HW_DATAMODUL_DATA_MODE_CONTINUOUS_SYNC     (0b10 << 5)
+#define RFM69HW_DATAMODUL_DATA_MODE_CONTINUOUS_NO_SYNC  (0b11 << 5)
+#define RFM69HW_DATAMODUL_MODULATION_TYPE_MASK          (0b11 << 3)
+#define RFM69HW_DATAMODUL_MODULATION_TYPE_FSK           (0b00 << 3) // Default
+#define RFM69HW_DATAMODUL_MODULATION_TYPE_OOK           (0b01 << 3)
+#define RFM69HW_DATAMODUL_MODULATION_SHAPING_MASK       (0b11 << 0)
+#define RFM69HW_DATAMODUL_MODULATION_SHAPING_00         (0b00 << 0) // Default
+#define RFM69HW_DATAMODUL_MODULATION_SHAPING_01         (0b01 << 0)
+#define RFM69HW_DATAMODUL_MODULATION_SHAPING_10         (0b10 << 0)
+#define RFM69HW_DATAMODUL_MODULATION_SHAPING_11         (0b11 << 0)
+
 // 0x0A - Oscillator masks
 #define RFM69HW_OSC1_RC_CAL_START    (1 << 7)
 #define RFM69HW_OSC1_RC_CAL_DONE     (1 << 6)
 
+// 0x0D - Listen 1 masks
+#define RFM69HW_LISTEN1_RESOL_IDLE_MASK     (0b11 << 6)
+#define RFM69HW_LISTEN1_RESOL_IDLE_64US     (0b01 << 6)
+#define RFM69HW_LISTEN1_RESOL_IDLE_4_1MS    (0b10 << 6) // Default
+#define RFM69HW_LISTEN1_RESOL_IDLE_262MS    (0b11 << 6)
+#define RFM69HW_LISTEN1_RESOL_RX_MASK       (0b11 << 4)
+#define RFM69HW_LISTEN1_RESOL_RX_64US       (0b01 << 4) // Default
+#define RFM69HW_LISTEN1_RESOL_RX_4_1MS      (0b10 << 4)
+#define RFM69HW_LISTEN1_RESOL_RX_262MS      (0b11 << 4)
+#define RFM69HW_LISTEN1_CRITERIA_RSSI       (0 << 3) // Default
+#define RFM69HW_LISTEN1_CRITERIA_SYNC       (1 << 3)
+#define RFM69HW_LISTEN1_END_MASK            (0b11 << 1)
+#define RFM69HW_LISTEN1_END_STAY_RX         (0b00 << 1)
+#define RFM69HW_LISTEN1_END_MODE            (0b01 << 1) // Default
+#define RFM69HW_LISTEN1_END_RESUME          (0b10 << 1)
+
+// 0x11 - PA level masks
+#define RFM69HW_PALEVEL_PA0_ON               (1 << 7) // Default
+#define RFM69HW_PALEVEL_PA1_ON               (1 << 6)
+#define RFM69HW_PALEVEL_PA2_ON               (1 << 5)
+#define RFM69HW_PALEVEL_OUTPUT_POWER_MASK    (0b11111 << 0)
+
+// 0x13 - Over current protection masks
+#define RFM69HW_OCP_OFF          (0 << 4)
+#define RFM69HW_OCP_ON           (1 << 4) // Default
+#define RFM69HW_OCP_TRIM_MASK    (0b1111 << 0)
+#define RFM69HW_OCP_TRIM_95MA    (0b1010 << 0) // Default
+
+// 0x19 - RX bandwidth masks
+#define RFM69HW_RXBW_DCC_FREQ_MASK    (0b111 << 5)
+#define RFM69HW_RXBW_DCC_FREQ_4       (0b010 << 5) // Default
+#define RFM69HW_RXBW_MANT_MASK        (0b11 << 3)
+#define RFM69HW_RXBW_MANT_16          (0b00 << 3)
+#define RFM69HW_RXBW_MANT_20          (0b01 << 3)
+#define RFM69HW_RXBW_MANT_24          (0b10 << 3) // Default
+#define RFM69HW_RXBW_EXP_MASK         (0b111 << 0)
+
+// 0x1A - AFC bandwidth masks
+#define RFM69HW_AFCBW_DCC_FREQ_MASK    (0b111 << 5)
+#define RFM69HW_AFCBW_DCC_FREQ_1       (0b100 << 5) // Default
+#define RFM69HW_AFCBW_MANT_MASK        (0b11 << 3)
+#define RFM69HW_AFCBW_MANT_16          (0b00 << 3)
+#define RFM69HW_AFCBW_MANT_20          (0b01 << 3) // Default
+#define RFM69HW_AFCBW_MANT_24          (0b10 << 3)
+#define RFM69HW_AFCBW_EXP_MASK         (0b111 << 0)
+
+// 0x1E - AFC and FEI control masks
+#define RFM69HW_AFCFEI_FEI_DONE          (1 << 6)
+#define RFM69HW_AFCFEI_FEI_START         (1 << 5)
+#define RFM69HW_AFCFEI_AFC_DONE          (1 << 4)
+#define RFM69HW_AFCFEI_AFC_AUTOCLEAR_ON  (1 << 3)
+#define RFM69HW_AFCFEI_AFC_AUTO_ON       (1 << 2)
+#define RFM69HW_AFCFEI_AFC_CLEAR         (1 << 1)
+#define RFM69HW_AFCFEI_AFC_START         (1 << 0)
+
 // 0x23 - RSSI config masks
 #define RFM69HW_RSSICONFIG_RSSI_DONE     (1 << 1)
 #define RFM69HW_RSSICONFIG_RSSI_START    (1 << 0)
 
+// 0x25 - Digital IO mapping 1 masks
+#define RFM69HW_DIOMAPPING1_DIO0_MASK     (0b11 << 6)
+#define RFM69HW_DIOMAPPING1_DIO0_00       (0b00 << 6) // Default
+#define RFM69HW_DIOMAPPING1_DIO0_01       (0b01 << 6)
+#define RFM69HW_DIOMAPPING1_DIO0_10       (0b10 << 6)
+#define RFM69HW_DIOMAPPING1_DIO0_11       (0b11 << 6)
+#define RFM69HW_DIOMAPPING1_DIO1_MASK     (0b11 << 4)
+#define RFM69HW_DIOMAPPING1_DIO1_00       (0b00 << 4) // Default
+#define RFM69HW_DIOMAPPING1_DIO1_01       (0b01 << 4)
+#define RFM69HW_DIOMAPPING1_DIO1_10       (0b10 << 4)
+#define RFM69HW_DIOMAPPING1_DIO1_11       (0b11 << 4)
+#define RFM69HW_DIOMAPPING1_DIO2_MASK     (0b11 << 2)
+#define RFM69HW_DIOMAPPING1_DIO2_00       (0b00 << 2) // Default
+#define RFM69HW_DIOMAPPING1_DIO2_01       (0b01 << 2)
+#define RFM69HW_DIOMAPPING1_DIO2_10       (0b10 << 2)
+#define RFM69HW_DIOMAPPING1_DIO2_11       (0b11 << 2)
+#define RFM69HW_DIOMAPPING1_DIO3_MASK     (0b11 << 0)
+#define RFM69HW_DIOMAPPING1_DIO3_00       (0b00 << 0) // Default
+#define RFM69HW_DIOMAPPING1_DIO3_01       (0b01 << 0)
+#define RFM69HW_DIOMAPPING1_DIO3_10       (0b10 << 0)
+#define RFM69HW_DIOMAPPING1_DIO3_11       (0b11 << 0)
+
 // 0x26 - Digital IO mapping 2 masks
 #define RFM69HW_DIOMAPPING2_DIO4_MASK     (0b11 << 6)
 #define RFM69HW_DIOMAPPING2_DIO4_00       (0b00 << 6) // Default
@@ -173,13 +264,79 @@ THE SOFTWARE.
 #define RFM69HW_IRQFLAGS2_PAYLOAD_READY     (1 << 2)
 #define RFM69HW_IRQFLAGS2_CRC_OK            (1 << 1)
 
+// 0x2E - Sync config masks
+#define RFM69HW_SYNCCONFIG_SYNC_OFF             (0 << 7)
+#define RFM69HW_SYNCCONFIG_SYNC_ON              (1 << 7) // Default
+#define RFM69HW_SYNCCONFIG_FIFO_FILL_AUTO       (0 << 6) // Default
+#define RFM69HW_SYNCCONFIG_FIFO_FILL_MANUAL     (1 << 6)
+#define RFM69HW_SYNCCONFIG_SYNC_SIZE_MASK       (0b111 << 3)
+#define RFM69HW_SYNCCONFIG_SYNC_SIZE_SHIFT      (3)
+#define RFM69HW_SYNCCONFIG_SYNC_TOL_MASK        (0b111 << 0)
+
+// 0x37 - Packet config 1 masks
+#define RFM69HW_PACKETCONFIG1_FORMAT_FIXED              (0 << 7) // Default
+#define RFM69HW_PACKETCONFIG1_FORMAT_VARIABLE           (1 << 7)
+#define RFM69HW_PACKETCONFIG1_DC_FREE_MASK              (0b11 << 5)
+#define RFM69HW_PACKETCONFIG1_DC_FREE_NONE              (0b00 << 5) // Default
+#define RFM69HW_PACKETCONFIG1_DC_FREE_MANCHESTER        (0b01 << 5)
+#define RFM69HW_PACKETCONFIG1_DC_FREE_WHITENING         (0b10 << 5)
+#define RFM69HW_PACKETCONFIG1_CRC_OFF                   (0 << 4)
+#define RFM69HW_PACKETCONFIG1_CRC_ON                    (1 << 4) // Default
+#define RFM69HW_PACKETCONFIG1_CRC_AUTO_CLEAR_ON         (0 << 3) // Default
+#define RFM69HW_PACKETCONFIG1_CRC_AUTO_CLEAR_OFF        (1 << 3)
+#define RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK    (0b11 << 1)
+#define RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_NONE    (0b00 << 1) // Default
+#define RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_NODE    (0b01 << 1)
+#define RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_BOTH    (0b10 << 1)
+
+// 0x3B - Auto modes masks
+#define RFM69HW_AUTOMODES_ENTER_MASK                    (0b111 << 5)
+#define RFM69HW_AUTOMODES_ENTER_OFF                     (0b000 << 5) // Default
+#define RFM69HW_AUTOMODES_ENTER_FIFO_NOT_EMPTY          (0b001 << 5)
+#define RFM69HW_AUTOMODES_ENTER_FIFO_LEVEL              (0b010 << 5)
+#define RFM69HW_AUTOMODES_ENTER_CRC_OK                  (0b011 << 5)
+#define RFM69HW_AUTOMODES_ENTER_PAYLOAD_READY           (0b100 << 5)
+#define RFM69HW_AUTOMODES_ENTER_SYNC_ADDRESS            (0b101 << 5)
+#define RFM69HW_AUTOMODES_ENTER_PACKET_SENT             (0b110 << 5)
+#define RFM69HW_AUTOMODES_ENTER_FIFO_EMPTY              (0b111 << 5)
+#define RFM69HW_AUTOMODES_EXIT_MASK                     (0b111 << 2)
+#define RFM69HW_AUTOMODES_EXIT_OFF                      (0b000 << 2) // Default
+#define RFM69HW_AUTOMODES_EXIT_FIFO_EMPTY               (0b001 << 2)
+#define RFM69HW_AUTOMODES_EXIT_FIFO_LEVEL_OR_TIMEOUT    (0b010 << 2)
+#define RFM69HW_AUTOMODES_EXIT_CRC_OK_OR_TIMEOUT        (0b011 << 2)
+#define RFM69HW_AUTOMODES_EXIT_PAYLOAD_READY_OR_TIMEOUT (0b100 << 2)
+#define RFM69HW_AUTOMODES_EXIT_SYNC_ADDRESS_OR_TIMEOUT  (0b101 << 2)
+#define RFM69HW_AUTOMODES_EXIT_PACKET_SENT              (0b110 << 2)
+#define RFM69HW_AUTOMODES_EXIT_TIMEOUT                  (0b111 << 2)
+#define RFM69HW_AUTOMODES_INTERMEDIATE_MASK             (0b11 << 0)
+#define RFM69HW_AUTOMODES_INTERMEDIATE_SLEEP            (0b00 << 0) // Default
+#define RFM69HW_AUTOMODES_INTERMEDIATE_STANDBY          (0b01 << 0)
+#define RFM69HW_AUTOMODES_INTERMEDIATE_RX               (0b10 << 0)
+#define RFM69HW_AUTOMODES_INTERMEDIATE_TX               (0b11 << 0)
+
 // 0x3C - FIFO threshold masks
 #define RFM69HW_FIFOTHRESH_TX_START_FIFO_LEVEL        (0 << 7) // Reset value
 #define RFM69HW_FIFOTHRESH_TX_START_FIFO_NOT_EMPTY    (1 << 7) // Recommended
 #define RFM69HW_FIFOTHRESH_FIFO_THRESHOLD_MASK        (0b1111111 << 0)
 
+// 0x3D - Packet config 2 masks
+#define RFM69HW_PACKETCONFIG2_INTER_PACKET_RX_DELAY_MASK    (0b1111 << 4)
+#define RFM69HW_PACKETCONFIG2_RESTART_RX                    (1 << 2)
+#define RFM69HW_PACKETCONFIG2_AUTO_RX_RESTART_OFF           (0 << 1)
+#define RFM69HW_PACKETCONFIG2_AUTO_RX_RESTART_ON            (1 << 1) // Default
+#define RFM69HW_PACKETCONFIG2_AES_OFF                       (0 << 0) // Default
+#define RFM69HW_PACKETCONFIG2_AES_ON                        (1 << 0)
+
 // 0x4E - Temperature 1 masks
 #define RFM69HW_TEMP1_MEAS_START      (1 << 3)
 #define RFM69HW_TEMP1_MEAS_RUNNING    (1 << 2)
 
+// 0x5A - High power PA setting 1 values
+#define RFM69HW_TESTPA1_NORMAL    (0x55) // Default
+#define RFM69HW_TESTPA1_BOOST     (0x5D)
+
+// 0x5C - High power PA setting 2 values
+#define RFM69HW_TESTPA2_NORMAL    (0x70) // Default
+#define RFM69HW_TESTPA2_BOOST     (0x7C)
+
 #endif // _RFM69HW_REGISTERS_H_
@@ -0,0 +1,839 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+
+#include "RFM69HWSimulator.h"
+
+#include <string.h>
+
+#include "RFM69HW_registers.h"
+
+#define FIFO_SIZE  (66)
+
+// Frequencies further apart than this, in synthesizer steps (about 61 kHz),
+// do not hear each other
+#define CAPTURE_RANGE  (1000)
+
+// Level reported for every received frame
+#define SIGNAL_DBM  (-50)
+
+// Power-on values of the registers, as listed in the datasheet
+static const uint8_t resetValues[][2] = {
+    { RFM69HW_OPMODE, 0x04 },        { RFM69HW_BITRATEMSB, 0x1A },    { RFM69HW_BITRATELSB, 0x0B },
+    { RFM69HW_FDEVLSB, 0x52 },       { RFM69HW_FRFMSB, 0xE4 },        { RFM69HW_FRFMID, 0xC0 },
+    { RFM69HW_OSC1, 0x41 },          { RFM69HW_RESERVED0C, 0x02 },    { RFM69HW_LISTEN1, 0x92 },
+    { RFM69HW_LISTEN2, 0xF5 },       { RFM69HW_LISTEN3, 0x20 },       { RFM69HW_VERSION, 0x24 },
+    { RFM69HW_PALEVEL, 0x9F },       { RFM69HW_PARAMP, 0x09 },        { RFM69HW_OCP, 0x1A },
+    { RFM69HW_LNA, 0x88 },           { RFM69HW_RXBW, 0x55 },          { RFM69HW_AFCBW, 0x8B },
+    { RFM69HW_AFCFEI, 0x10 },        { RFM69HW_RSSICONFIG, 0x02 },    { RFM69HW_RSSIVALUE, 0xFF },
+    { RFM69HW_DIOMAPPING2, 0x05 },   { RFM69HW_RSSITHRESH, 0xE4 },    { RFM69HW_PREAMBLELSB, 0x03 },
+    { RFM69HW_SYNCCONFIG, 0x98 },    { RFM69HW_PACKETCONFIG1, 0x10 }, { RFM69HW_PAYLOADLENGTH, 0x40 },
+    { RFM69HW_FIFOTHRESH, 0x0F },    { RFM69HW_PACKETCONFIG2, 0x02 }, { RFM69HW_TEMP1, 0x01 },
+    { RFM69HW_TESTLNA, 0x1B },       { RFM69HW_TESTPA1, 0x55 },       { RFM69HW_TESTPA2, 0x70 },
+    { RFM69HW_TESTDAGC, 0x30 },
+};
+
+// Wrap-around safe comparison of two points in time
+static bool before(const uint32_t a, const uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+RFM69HWAir::RFM69HWAir() :
+    clock(0),
+    interrupted(false),
+    corrupt(false)
+{
+    injection.active = false;
+}
+
+uint32_t RFM69HWAir::now() const {
+    return clock;
+}
+
+void RFM69HWAir::advance(const uint32_t us) {
+    // Step from one byte on air to the next, so that long waits cost no more
+    // than the traffic which happens during them
+    const uint32_t target = clock + us;
+    while (before(clock, target)) {
+        uint32_t next = target;
+        for (size_t i = 0; i < radios.size(); ++i) {
+            uint32_t time;
+            if (radios[i]->nextEvent(time) && before(time, next))
+                next = time;
+        }
+        if (injection.active && before(injection.next, next))
+            next = injection.next;
+
+        if (before(clock, next))
+            clock = next;
+
+        for (size_t i = 0; i < radios.size(); ++i)
+            radios[i]->tick();
+        tickInjection();
+    }
+
+    dispatch();
+}
+
+void RFM69HWAir::inject(const uint32_t frf, const std::vector<uint8_t>& bytes, const uint32_t bitrate) {
+    // Preamble and sync word go out first
+    injection.active = true;
+    injection.frame.start = clock;
+    injection.frame.frf = frf;
+    injection.frame.bytes = bytes;
+    injection.frame.crcOk = true;
+    injection.byteTime = 8000000 / bitrate + 1;
+    injection.next = clock + 7 * injection.byteTime;
+    injection.sent = 0;
+}
+
+void RFM69HWAir::corruptNext() {
+    corrupt = true;
+}
+
+const std::vector<RFM69HWAir::Frame>& RFM69HWAir::frames() const {
+    return log;
+}
+
+void RFM69HWAir::clearFrames() {
+    log.clear();
+}
+
+void RFM69HWAir::attach(RFM69HWSimulator* radio) {
+    radios.push_back(radio);
+}
+
+void RFM69HWAir::detach(RFM69HWSimulator* radio) {
+    for (size_t i = 0; i < radios.size(); ++i) {
+        if (radios[i] == radio) {
+            radios.erase(radios.begin() + i);
+            return;
+        }
+    }
+}
+
+void RFM69HWAir::deliver(const void* source, const uint32_t frf, const uint8_t value, const bool first) {
+    for (size_t i = 0; i < radios.size(); ++i) {
+        if (radios[i] != source)
+            radios[i]->receiveByte(source, frf, value, first);
+    }
+}
+
+void RFM69HWAir::finish(const void* source, Frame& frame) {
+    frame.crcOk = !corrupt;
+    corrupt = false;
+    log.push_back(frame);
+
+    for (size_t i = 0; i < radios.size(); ++i) {
+        if (radios[i] != source)
+            radios[i]->receiveEnd(source, frame.crcOk);
+    }
+}
+
+void RFM69HWAir::tickInjection() {
+    while (injection.active && !before(clock, injection.next)) {
+        if (injection.sent == injection.frame.bytes.size()) {
+            injection.active = false;
+            finish(&injection, injection.frame);
+            break;
+        }
+
+        deliver(&injection, injection.frame.frf, injection.frame.bytes[injection.sent], injection.sent == 0);
+        ++injection.sent;
+
+        // The CRC follows the last byte
+        injection.next += injection.byteTime * (injection.sent == injection.frame.bytes.size() ? 3 : 1);
+    }
+}
+
+bool RFM69HWAir::busy() const {
+    for (size_t i = 0; i < radios.size(); ++i) {
+        if (radios[i]->selected)
+            return true;
+    }
+
+    return false;
+}
+
+void RFM69HWAir::dispatch() {
+    // Interrupts are held off while any SPI transaction is in progress, as
+    // SPI.usingInterrupt() does, and while another handler is running
+    if (interrupted || busy())
+        return;
+
+    bool ran = true;
+    while (ran) {
+        ran = false;
+        for (size_t i = 0; i < radios.size(); ++i) {
+            RFM69HWSimulator* radio = radios[i];
+            if (!radio->pending || !radio->handler)
+                continue;
+
+            radio->pending = false;
+            const uint32_t start = clock;
+            interrupted = true;
+            radio->interrupted = true;
+            radio->handler();
+            radio->interrupted = false;
+            interrupted = false;
+
+            ++radio->interruptCount;
+            if (clock - start > radio->interruptLongest)
+                radio->interruptLongest = clock - start;
+            ran = true;
+        }
+    }
+}
+
+RFM69HWSimulator::RFM69HWSimulator(RFM69HWAir& air) :
+    air(air),
+    responding(true),
+    rssi(-100),
+    celsius(25),
+    frequencyError(0),
+    active(RFM69HW_OPMODE_MODE_STANDBY),
+    intermediate(false),
+    autoEnter(false),
+    packetSent(false),
+    payloadReady(false),
+    crcOk(false),
+    overrun(false),
+    txOn(false),
+    txStarted(false),
+    txEnding(false),
+    txDone(false),
+    txNext(0),
+    txExpected(0),
+    rxSource(NULL),
+    rxDrop(false),
+    rxCount(0),
+    rxExpected(0),
+    afc(0),
+    selected(false),
+    addressed(false),
+    writing(false),
+    address(0),
+    handler(NULL),
+    dio0(false),
+    pending(false),
+    interrupted(false)
+{
+    memset(regs, 0, sizeof(regs));
+    for (size_t i = 0; i < sizeof(resetValues) / sizeof(resetValues[0]); ++i)
+        regs[resetValues[i][0]] = resetValues[i][1];
+
+    resetCounters();
+    air.attach(this);
+}
+
+RFM69HWSimulator::~RFM69HWSimulator() {
+    air.detach(this);
+}
+
+void RFM69HWSimulator::spiBegin() {
+}
+
+void RFM69HWSimulator::spiUsingInterrupt(const int8_t pin) {
+    (void)pin;
+}
+
+void RFM69HWSimulator::spiSelect(const int8_t slaveSelectPin) {
+    (void)slaveSelectPin;
+    selected = true;
+    addressed = false;
+    ++transactionCount;
+    if (interrupted)
+        ++interruptTransactionCount;
+}
+
+void RFM69HWSimulator::spiDeselect(const int8_t slaveSelectPin) {
+    (void)slaveSelectPin;
+    selected = false;
+    update();
+    air.dispatch();
+}
+
+uint8_t RFM69HWSimulator::spiTransfer(const uint8_t value) {
+    ++byteCount;
+
+    // The first byte is the register address, with the top bit set for a
+    // write. The address then moves on with every byte, except for the FIFO.
+    if (!addressed) {
+        addressed = true;
+        writing = value & 0x80;
+        address = value & 0x7F;
+        return 0;
+    }
+
+    uint8_t result = 0;
+    if (responding && writing)
+        writeRegister(address, value);
+    else if (responding)
+        result = readRegister(address);
+
+    if (address != RFM69HW_FIFO)
+        address = (address + 1) & 0x7F;
+
+    update();
+    return result;
+}
+
+void RFM69HWSimulator::spiSend(const uint8_t* buffer, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+        spiTransfer(buffer[i]);
+}
+
+void RFM69HWSimulator::spiReceive(uint8_t* buffer, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+        buffer[i] = spiTransfer(0x00);
+}
+
+void RFM69HWSimulator::pinOutput(const int8_t pin, const bool high) {
+    (void)pin;
+    (void)high;
+}
+
+void RFM69HWSimulator::pinInput(const int8_t pin) {
+    (void)pin;
+}
+
+void RFM69HWSimulator::pinWrite(const int8_t pin, const bool high) {
+    (void)pin;
+    (void)high;
+}
+
+void RFM69HWSimulator::attachInterrupt(const int8_t pin, void (*handler)()) {
+    (void)pin;
+    this->handler = handler;
+}
+
+void RFM69HWSimulator::delay(const uint32_t ms) {
+    air.advance(ms * 1000);
+}
+
+void RFM69HWSimulator::delayMicroseconds(const uint32_t us) {
+    air.advance(us);
+}
+
+uint32_t RFM69HWSimulator::millis() {
+    return micros() / 1000;
+}
+
+uint32_t RFM69HWSimulator::micros() {
+    // Reading the clock takes time too, so that polling loops end
+    air.advance(1);
+    return air.now();
+}
+
+uint8_t RFM69HWSimulator::reg(const uint8_t address) const {
+    switch (address) {
+    case RFM69HW_IRQFLAGS1:
+        return irqFlags1();
+    case RFM69HW_IRQFLAGS2:
+        return irqFlags2();
+    default:
+        return regs[address & 0x7F];
+    }
+}
+
+uint8_t RFM69HWSimulator::mode() const {
+    return active;
+}
+
+size_t RFM69HWSimulator::fifoLevel() const {
+    return fifo.size();
+}
+
+void RFM69HWSimulator::setResponding(const bool responding) {
+    this->responding = responding;
+}
+
+void RFM69HWSimulator::setRssi(const int8_t dbm) {
+    rssi = dbm;
+}
+
+void RFM69HWSimulator::setTemperature(const int8_t celsius) {
+    this->celsius = celsius;
+}
+
+void RFM69HWSimulator::setFrequencyError(const int32_t steps) {
+    frequencyError = steps;
+}
+
+uint32_t RFM69HWSimulator::transactions() const {
+    return transactionCount;
+}
+
+uint32_t RFM69HWSimulator::bytes() const {
+    return byteCount;
+}
+
+uint32_t RFM69HWSimulator::interrupts() const {
+    return interruptCount;
+}
+
+uint32_t RFM69HWSimulator::interruptTransactions() const {
+    return interruptTransactionCount;
+}
+
+uint32_t RFM69HWSimulator::longestInterrupt() const {
+    return interruptLongest;
+}
+
+uint32_t RFM69HWSimulator::restarts() const {
+    return restartCount;
+}
+
+void RFM69HWSimulator::resetCounters() {
+    transactionCount = 0;
+    byteCount = 0;
+    interruptCount = 0;
+    interruptTransactionCount = 0;
+    interruptLongest = 0;
+    restartCount = 0;
+}
+
+uint8_t RFM69HWSimulator::readRegister(const uint8_t address) {
+    switch (address) {
+    case RFM69HW_FIFO: {
+        if (fifo.empty())
+            return 0;
+
+        const uint8_t value = fifo.front();
+        fifo.pop_front();
+
+        // Once the packet has been read out the receiver starts over
+        if (fifo.empty() && payloadReady) {
+            payloadReady = false;
+            crcOk = false;
+        }
+        return value;
+    }
+    case RFM69HW_IRQFLAGS1:
+        return irqFlags1();
+    case RFM69HW_IRQFLAGS2:
+        return irqFlags2();
+    case RFM69HW_AFCMSB:
+        return (uint16_t)afc >> 8;
+    case RFM69HW_AFCLSB:
+        return (uint8_t)afc;
+    case RFM69HW_RSSIVALUE:
+        return -2 * (rxSource ? SIGNAL_DBM : rssi);
+    case RFM69HW_TEMP2:
+        return 170 - celsius;
+    default:
+        return regs[address];
+    }
+}
+
+void RFM69HWSimulator::writeRegister(const uint8_t address, const uint8_t value) {
+    switch (address) {
+    case RFM69HW_FIFO:
+        push(value);
+        break;
+    case RFM69HW_OPMODE:
+        // Writing the op mode takes the device out of any intermediate mode.
+        // Listen mode ends when it is aborted.
+        regs[address] = value & ~RFM69HW_OPMODE_LISTEN_ABORT;
+        if (value & RFM69HW_OPMODE_LISTEN_ABORT)
+            regs[address] &= ~RFM69HW_OPMODE_LISTEN_ON;
+        intermediate = false;
+        break;
+    case RFM69HW_VERSION:
+    case RFM69HW_IRQFLAGS1:
+        break;
+    case RFM69HW_IRQFLAGS2:
+        // Setting the overrun flag clears the FIFO
+        if (value & RFM69HW_IRQFLAGS2_FIFO_OVERRUN)
+            clearFifo();
+        break;
+    case RFM69HW_PACKETCONFIG2:
+        // The restart trigger always reads back as zero
+        if (value & RFM69HW_PACKETCONFIG2_RESTART_RX)
+            restartReceiver();
+        regs[address] = value & ~RFM69HW_PACKETCONFIG2_RESTART_RX;
+        break;
+    case RFM69HW_OSC1:
+        regs[address] = RFM69HW_OSC1_RC_CAL_DONE | 0x01;
+        break;
+    case RFM69HW_AFCFEI:
+        if (value & RFM69HW_AFCFEI_AFC_CLEAR)
+            afc = 0;
+        regs[address] = (value & (RFM69HW_AFCFEI_AFC_AUTOCLEAR_ON | RFM69HW_AFCFEI_AFC_AUTO_ON)) |
+                        RFM69HW_AFCFEI_AFC_DONE;
+        break;
+    case RFM69HW_RSSICONFIG:
+        regs[address] = RFM69HW_RSSICONFIG_RSSI_DONE;
+        break;
+    case RFM69HW_TEMP1:
+        regs[address] = 0x01;
+        break;
+    default:
+        // The AES key can only be written in sleep or standby
+        if (address >= RFM69HW_AESKEY1 && address <= RFM69HW_AESKEY16 &&
+            active != RFM69HW_OPMODE_MODE_SLEEP && active != RFM69HW_OPMODE_MODE_STANDBY)
+            break;
+        regs[address] = value;
+        break;
+    }
+}
+
+uint8_t RFM69HWSimulator::irqFlags1() const {
+    uint8_t flags = RFM69HW_IRQFLAGS1_MODE_READY;
+    if (active == RFM69HW_OPMODE_MODE_RX)
+        flags |= RFM69HW_IRQFLAGS1_RX_READY | RFM69HW_IRQFLAGS1_PLL_LOCK;
+    if (active == RFM69HW_OPMODE_MODE_TX)
+        flags |= RFM69HW_IRQFLAGS1_TX_READY | RFM69HW_IRQFLAGS1_PLL_LOCK;
+    if (intermediate)
+        flags |= RFM69HW_IRQFLAGS1_AUTO_MODE;
+    if (rxSource && !rxDrop)
+        flags |= RFM69HW_IRQFLAGS1_SYNC_ADDR_MATCH;
+    return flags;
+}
+
+uint8_t RFM69HWSimulator::irqFlags2() const {
+    const size_t threshold = regs[RFM69HW_FIFOTHRESH] & RFM69HW_FIFOTHRESH_FIFO_THRESHOLD_MASK;
+    uint8_t flags = 0;
+    if (fifo.size() == FIFO_SIZE)
+        flags |= RFM69HW_IRQFLAGS2_FIFO_FULL;
+    if (!fifo.empty())
+        flags |= RFM69HW_IRQFLAGS2_FIFO_NOT_EMPTY;
+    if (fifo.size() > threshold)
+        flags |= RFM69HW_IRQFLAGS2_FIFO_LEVEL;
+    if (overrun)
+        flags |= RFM69HW_IRQFLAGS2_FIFO_OVERRUN;
+    if (packetSent)
+        flags |= RFM69HW_IRQFLAGS2_PACKET_SENT;
+    if (payloadReady)
+        flags |= RFM69HW_IRQFLAGS2_PAYLOAD_READY;
+    if (crcOk)
+        flags |= RFM69HW_IRQFLAGS2_CRC_OK;
+    return flags;
+}
+
+void RFM69HWSimulator::push(const uint8_t value) {
+    if (fifo.size() == FIFO_SIZE) {
+        overrun = true;
+        return;
+    }
+
+    fifo.push_back(value);
+}
+
+void RFM69HWSimulator::clearFifo() {
+    fifo.clear();
+    overrun = false;
+    payloadReady = false;
+    crcOk = false;
+}
+
+uint32_t RFM69HWSimulator::byteTime() const {
+    // The bit rate register holds FXOSC / bit rate, so one byte takes a
+    // quarter of it in microseconds
+    const uint32_t bitrate = ((uint32_t)regs[RFM69HW_BITRATEMSB] << 8) | regs[RFM69HW_BITRATELSB];
+    return bitrate / 4 + 1;
+}
+
+uint32_t RFM69HWSimulator::carrier() const {
+    const uint32_t frf = ((uint32_t)regs[RFM69HW_FRFMSB] << 16) |
+                         ((uint32_t)regs[RFM69HW_FRFMID] << 8) | regs[RFM69HW_FRFLSB];
+    return frf + frequencyError;
+}
+
+bool RFM69HWSimulator::nextEvent(uint32_t& time) const {
+    time = txNext;
+    return txOn && txStarted && !txDone;
+}
+
+void RFM69HWSimulator::tick() {
+    while (txOn && txStarted && !txDone && !before(air.now(), txNext)) {
+        if (txEnding) {
+            // The CRC is out, which completes the packet. The device stays in
+            // TX until told otherwise.
+            txDone = true;
+            packetSent = true;
+            air.finish(this, txFrame);
+            break;
+        }
+
+        // Nothing to send leaves the transmitter idling on the carrier
+        if (fifo.empty()) {
+            txNext += byteTime();
+            continue;
+        }
+
+        const uint8_t value = fifo.front();
+        fifo.pop_front();
+
+        const bool first = txFrame.bytes.empty();
+        if (first)
+            txFrame.start = air.now();
+        txFrame.bytes.push_back(value);
+        air.deliver(this, carrier(), value, first);
+
+        const uint8_t packetConfig = regs[RFM69HW_PACKETCONFIG1];
+        if (first && (packetConfig & RFM69HW_PACKETCONFIG1_FORMAT_VARIABLE))
+            txExpected = 1 + value;
+        else if (first)
+            txExpected = regs[RFM69HW_PAYLOADLENGTH];
+
+        txEnding = txExpected && txFrame.bytes.size() == txExpected;
+        txNext += byteTime() * (txEnding ? 2 : 1);
+    }
+
+    update();
+}
+
+void RFM69HWSimulator::startTransmit() {
+    // The TX start condition is either the first byte in the FIFO or the FIFO
+    // rising above the threshold
+    const uint8_t fifoThresh = regs[RFM69HW_FIFOTHRESH];
+    const bool start = (fifoThresh & RFM69HW_FIFOTHRESH_TX_START_FIFO_NOT_EMPTY) ?
+                       !fifo.empty() :
+                       fifo.size() > (fifoThresh & RFM69HW_FIFOTHRESH_FIFO_THRESHOLD_MASK);
+    if (!txOn || txStarted || !start)
+        return;
+
+    // Preamble and sync word go out ahead of the first byte
+    const uint8_t syncConfig = regs[RFM69HW_SYNCCONFIG];
+    const uint32_t preamble = ((uint32_t)regs[RFM69HW_PREAMBLEMSB] << 8) | regs[RFM69HW_PREAMBLELSB];
+    const uint32_t sync = (syncConfig & RFM69HW_SYNCCONFIG_SYNC_ON) ?
+                          ((syncConfig & RFM69HW_SYNCCONFIG_SYNC_SIZE_MASK) >> RFM69HW_SYNCCONFIG_SYNC_SIZE_SHIFT) + 1 : 0;
+
+    txStarted = true;
+    txEnding = false;
+    txDone = false;
+    txExpected = 0;
+    txFrame.frf = carrier();
+    txFrame.bytes.clear();
+    txFrame.crcOk = true;
+    txNext = air.now() + (preamble + sync) * byteTime();
+}
+
+void RFM69HWSimulator::stopTransmit() {
+    // Leaving TX cuts off whatever was on air. Frames without an end, as in
+    // unlimited length packet mode, finish here.
+    if (txStarted && !txDone && !txFrame.bytes.empty()) {
+        RFM69HWAir::Frame frame = txFrame;
+        air.finish(this, frame);
+    }
+
+    txOn = false;
+    txStarted = false;
+    txDone = false;
+    packetSent = false;
+}
+
+void RFM69HWSimulator::receiveByte(const void* source, const uint32_t frf, const uint8_t value, const bool first) {
+    if (active != RFM69HW_OPMODE_MODE_RX)
+        return;
+
+    const int32_t offset = (int32_t)(frf - carrier());
+    if (first) {
+        // A receiver which is busy with a frame, or still holds one in the
+        // FIFO, does not see the next one. Neither does one tuned elsewhere.
+        if (rxSource || payloadReady || offset > CAPTURE_RANGE || offset < -CAPTURE_RANGE)
+            return;
+
+        rxSource = source;
+        rxDrop = false;
+        rxCount = 0;
+        rxExpected = 0;
+        if (regs[RFM69HW_AFCFEI] & RFM69HW_AFCFEI_AFC_AUTO_ON)
+            afc = offset;
+    } else if (source != rxSource || rxDrop) {
+        return;
+    }
+
+    const uint8_t packetConfig = regs[RFM69HW_PACKETCONFIG1];
+    const bool variable = packetConfig & RFM69HW_PACKETCONFIG1_FORMAT_VARIABLE;
+    const size_t index = rxCount++;
+
+    // Frames longer than the payload length register allows are dropped
+    if (index == 0 && variable) {
+        rxExpected = 1 + value;
+        if (value > regs[RFM69HW_PAYLOADLENGTH])
+            rxDrop = true;
+    } else if (index == 0) {
+        rxExpected = regs[RFM69HW_PAYLOADLENGTH];
+    }
+
+    // The address byte follows the length byte, if there is one
+    const uint8_t filtering = packetConfig & RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK;
+    if (index == (variable ? 1u : 0u) && filtering != RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_NONE) {
+        const bool node = value == regs[RFM69HW_NODEADRS];
+        const bool broadcast = filtering == RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_BOTH &&
+                               value == regs[RFM69HW_BROADCASTADRS];
+        if (!node && !broadcast)
+            rxDrop = true;
+    }
+
+    if (rxDrop) {
+        clearFifo();
+        return;
+    }
+
+    push(value);
+}
+
+void RFM69HWSimulator::receiveEnd(const void* source, const bool ok) {
+    if (source != rxSource)
+        return;
+
+    rxSource = NULL;
+    if (rxDrop || rxExpected == 0)
+        return;
+
+    // Frames which were cut short, or fail the CRC check, are cleared from
+    // the FIFO unless asked to keep them
+    const uint8_t packetConfig = regs[RFM69HW_PACKETCONFIG1];
+    const bool crcOn = packetConfig & RFM69HW_PACKETCONFIG1_CRC_ON;
+    const bool keep = packetConfig & RFM69HW_PACKETCONFIG1_CRC_AUTO_CLEAR_OFF;
+    if (rxCount < rxExpected || (crcOn && !ok && !keep)) {
+        clearFifo();
+        return;
+    }
+
+    payloadReady = true;
+    crcOk = ok || !crcOn;
+    update();
+}
+
+void RFM69HWSimulator::restartReceiver() {
+    ++restartCount;
+    rxSource = NULL;
+}
+
+void RFM69HWSimulator::update() {
+    sampleDio0();
+    runAutoModes();
+    applyMode();
+    startTransmit();
+    sampleDio0();
+}
+
+void RFM69HWSimulator::applyMode() {
+    uint8_t mode = regs[RFM69HW_OPMODE] & RFM69HW_OPMODE_MODE_MASK;
+    if (intermediate) {
+        static const uint8_t intermediateModes[] = {
+            RFM69HW_OPMODE_MODE_SLEEP,
+            RFM69HW_OPMODE_MODE_STANDBY,
+            RFM69HW_OPMODE_MODE_RX,
+            RFM69HW_OPMODE_MODE_TX,
+        };
+        mode = intermediateModes[regs[RFM69HW_AUTOMODES] & RFM69HW_AUTOMODES_INTERMEDIATE_MASK];
+    } else if (regs[RFM69HW_OPMODE] & RFM69HW_OPMODE_LISTEN_ON) {
+        // The listen mode duty cycle is not modelled. The receiver just stays
+        // on.
+        mode = RFM69HW_OPMODE_MODE_RX;
+    }
+
+    if (mode == active)
+        return;
+
+    if (active == RFM69HW_OPMODE_MODE_TX)
+        stopTransmit();
+    if (active == RFM69HW_OPMODE_MODE_RX)
+        rxSource = NULL;
+
+    active = mode;
+    if (active == RFM69HW_OPMODE_MODE_TX) {
+        txOn = true;
+        packetSent = false;
+    }
+}
+
+bool RFM69HWSimulator::autoCondition(const uint8_t condition) const {
+    // Conditions in the order of the enter field
+    switch (condition) {
+    case 1:
+        return !fifo.empty();
+    case 2:
+        return fifo.size() > (size_t)(regs[RFM69HW_FIFOTHRESH] & RFM69HW_FIFOTHRESH_FIFO_THRESHOLD_MASK);
+    case 3:
+        return crcOk;
+    case 4:
+        return payloadReady;
+    case 5:
+        return rxSource && !rxDrop;
+    case 6:
+        return packetSent;
+    case 7:
+        return fifo.empty();
+    default:
+        return false;
+    }
+}
+
+void RFM69HWSimulator::runAutoModes() {
+    const uint8_t autoModes = regs[RFM69HW_AUTOMODES];
+    const uint8_t enter = (autoModes & RFM69HW_AUTOMODES_ENTER_MASK) >> 5;
+    uint8_t exit = (autoModes & RFM69HW_AUTOMODES_EXIT_MASK) >> 2;
+    if (enter == 0) {
+        intermediate = false;
+        autoEnter = false;
+        return;
+    }
+
+    // The exit field starts with FifoEmpty where the enter field starts with
+    // FifoNotEmpty, and ends with a timeout which never expires here
+    if (exit == 7)
+        exit = 0;
+    else if (exit == 1)
+        exit = 7;
+
+    if (intermediate && exit != 0 && autoCondition(exit))
+        intermediate = false;
+
+    // The intermediate mode is entered on the rising edge of the condition
+    const bool condition = autoCondition(enter);
+    if (condition && !autoEnter && !intermediate)
+        intermediate = true;
+    autoEnter = condition;
+}
+
+void RFM69HWSimulator::sampleDio0() {
+    // What DIO0 carries depends on the mapping and on the mode
+    const uint8_t mapping = regs[RFM69HW_DIOMAPPING1] & RFM69HW_DIOMAPPING1_DIO0_MASK;
+    bool level = false;
+    if (active == RFM69HW_OPMODE_MODE_RX) {
+        if (mapping == RFM69HW_DIOMAPPING1_DIO0_00)
+            level = crcOk;
+        else if (mapping == RFM69HW_DIOMAPPING1_DIO0_01)
+            level = payloadReady;
+        else if (mapping == RFM69HW_DIOMAPPING1_DIO0_10)
+            level = rxSource && !rxDrop;
+    } else if (active == RFM69HW_OPMODE_MODE_TX) {
+        if (mapping == RFM69HW_DIOMAPPING1_DIO0_00)
+            level = packetSent;
+        else if (mapping == RFM69HW_DIOMAPPING1_DIO0_01)
+            level = true;
+    }
+
+    // Rising edges are latched until the handler can run
+    if (level && !dio0)
+        pending = true;
+    dio0 = level;
+}
@@ -0,0 +1,225 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+
+#ifndef _RFM69HWSIMULATOR_H_
+#define _RFM69HWSIMULATOR_H_
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include "RFM69HW_hal.h"
+
+class RFM69HWSimulator;
+
+// The medium shared by simulated radios, and the clock they all run on. Bytes
+// leave a transmitter one at a time at its bit rate and reach every receiver
+// tuned close enough to pick them up. Time only moves when a radio is asked
+// for it, or when it is told to wait.
+class RFM69HWAir {
+public:
+    // Everything which went on air, whether anybody received it or not. The
+    // bytes start with the length byte, as loaded into the FIFO.
+    struct Frame {
+        uint32_t start;
+        uint32_t frf;
+        std::vector<uint8_t> bytes;
+        bool crcOk;
+    };
+
+    RFM69HWAir();
+
+    uint32_t now() const;
+    void advance(const uint32_t us);
+
+    // Puts a frame on air from a transmitter which is not simulated itself
+    void inject(const uint32_t frf, const std::vector<uint8_t>& bytes, const uint32_t bitrate);
+
+    // Every receiver fails the CRC check of the next frame
+    void corruptNext();
+
+    const std::vector<Frame>& frames() const;
+    void clearFrames();
+
+private:
+    struct Injection {
+        bool active;
+        Frame frame;
+        uint32_t byteTime;
+        uint32_t next;
+        size_t sent;
+    };
+
+    void attach(RFM69HWSimulator* radio);
+    void detach(RFM69HWSimulator* radio);
+    void deliver(const void* source, const uint32_t frf, const uint8_t value, const bool first);
+    void finish(const void* source, Frame& frame);
+    void tickInjection();
+    bool busy() const;
+    void dispatch();
+
+    uint32_t clock;
+    bool interrupted;
+    bool corrupt;
+    std::vector<RFM69HWSimulator*> radios;
+    std::vector<Frame> log;
+    Injection injection;
+
+    friend class RFM69HWSimulator;
+};
+
+// Register-level model of the RFM69HW, standing in for the board behind the
+// driver. It covers the op modes and AutoModes, the FIFO and its flags, the
+// packet engine in both directions with length and address filtering, DIO0
+// and enough of the measurement registers for the driver to run. The test
+// hooks read the registers without side effects and count the bus traffic.
+class RFM69HWSimulator : public RFM69HWHal {
+public:
+    explicit RFM69HWSimulator(RFM69HWAir& air);
+    ~RFM69HWSimulator();
+
+    void spiBegin();
+    void spiUsingInterrupt(const int8_t pin);
+
+    void spiSelect(const int8_t slaveSelectPin);
+    void spiDeselect(const int8_t slaveSelectPin);
+
+    uint8_t spiTransfer(const uint8_t value);
+    void spiSend(const uint8_t* buffer, size_t size);
+    void spiReceive(uint8_t* buffer, size_t size);
+
+    void pinOutput(const int8_t pin, const bool high);
+    void pinInput(const int8_t pin);
+    void pinWrite(const int8_t pin, const bool high);
+
+    void attachInterrupt(const int8_t pin, void (*handler)());
+
+    void delay(const uint32_t ms);
+    void delayMicroseconds(const uint32_t us);
+    uint32_t millis();
+    uint32_t micros();
+
+    // Test hooks
+    uint8_t reg(const uint8_t address) const;
+    uint8_t mode() const;
+    size_t fifoLevel() const;
+
+    void setResponding(const bool responding);
+    void setRssi(const int8_t dbm);
+    void setTemperature(const int8_t celsius);
+    void setFrequencyError(const int32_t steps);
+
+    uint32_t transactions() const;
+    uint32_t bytes() const;
+    uint32_t interrupts() const;
+    uint32_t interruptTransactions() const;
+    uint32_t longestInterrupt() const;
+    uint32_t restarts() const;
+    void resetCounters();
+
+private:
+    uint8_t readRegister(const uint8_t address);
+    void writeRegister(const uint8_t address, const uint8_t value);
+    uint8_t irqFlags1() const;
+    uint8_t irqFlags2() const;
+
+    void push(const uint8_t value);
+    void clearFifo();
+
+    uint32_t byteTime() const;
+    uint32_t carrier() const;
+    bool nextEvent(uint32_t& time) const;
+    void tick();
+    void startTransmit();
+    void stopTransmit();
+
+    void receiveByte(const void* source, const uint32_t frf, const uint8_t value, const bool first);
+    void receiveEnd(const void* source, const bool crcOk);
+    void restartReceiver();
+
+    void update();
+    void applyMode();
+    void runAutoModes();
+    bool autoCondition(const uint8_t condition) const;
+    void sampleDio0();
+
+    RFM69HWAir& air;
+
+    uint8_t regs[0x80];
+    std::deque<uint8_t> fifo;
+    bool responding;
+    int8_t rssi;
+    int8_t celsius;
+    int32_t frequencyError;
+
+    // Op mode the device is actually in, which AutoModes can move away from
+    // the one in the OpMode register
+    uint8_t active;
+    bool intermediate;
+    bool autoEnter;
+
+    bool packetSent;
+    bool payloadReady;
+    bool crcOk;
+    bool overrun;
+
+    // Transmitter
+    bool txOn;
+    bool txStarted;
+    bool txEnding;
+    bool txDone;
+    uint32_t txNext;
+    size_t txExpected;
+    RFM69HWAir::Frame txFrame;
+
+    // Receiver. The source is whoever the frame being received comes from.
+    const void* rxSource;
+    bool rxDrop;
+    size_t rxCount;
+    size_t rxExpected;
+    int16_t afc;
+
+    // SPI transaction in progress
+    bool selected;
+    bool addressed;
+    bool writing;
+    uint8_t address;
+
+    void (*handler)();
+    bool dio0;
+    bool pending;
+    bool interrupted;
+
+    uint32_t transactionCount;
+    uint32_t byteCount;
+    uint32_t interruptCount;
+    uint32_t interruptTransactionCount;
+    uint32_t interruptLongest;
+    uint32_t restartCount;
+
+    friend class RFM69HWAir;
+};
+
+#endif // _RFM69HWSIMULATOR_H_
@@ -0,0 +1,803 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014-2016 Jacob McGladdery
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "RFM69HW.h"
+#include "RFM69HWGroup.h"
+#include "RFM69HWPower.h"
+#include "RFM69HWRate.h"
+#include "RFM69HWTdma.h"
+#include "RFM69HW_registers.h"
+#include "RFM69HWSimulator.h"
+
+namespace {
+
+// Two radios on the same channel, both started
+class RFM69HWTest : public ::testing::Test {
+protected:
+    RFM69HWTest() :
+        simA(air),
+        simB(air),
+        a(2, SS, -1, simA),
+        b(3, SS, -1, simB)
+    {
+    }
+
+    void SetUp() {
+        ASSERT_TRUE(a.begin());
+        ASSERT_TRUE(b.begin());
+    }
+
+    RFM69HWAir air;
+    RFM69HWSimulator simA;
+    RFM69HWSimulator simB;
+    RFM69HW a;
+    RFM69HW b;
+};
+
+std::vector<uint8_t> pattern(const size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = i * 7 + 1;
+    return bytes;
+}
+
+TEST_F(RFM69HWTest, BeginConfiguresPacketEngine) {
+    EXPECT_EQ(RFM69HW_MAX_PAYLOAD, simA.reg(RFM69HW_PAYLOADLENGTH));
+    EXPECT_EQ(RFM69HW_DIOMAPPING2_CLKOUT_OFF, simA.reg(RFM69HW_DIOMAPPING2) & RFM69HW_DIOMAPPING2_CLKOUT_MASK);
+    EXPECT_EQ(0x24, a.version());
+}
+
+TEST(RFM69HWSimulatorTest, BeginFailsWithoutDevice) {
+    RFM69HWAir air;
+    RFM69HWSimulator sim(air);
+    RFM69HW radio(2, SS, -1, sim);
+
+    sim.setResponding(false);
+    EXPECT_FALSE(radio.begin());
+}
+
+TEST_F(RFM69HWTest, SendToReachesReceiver) {
+    const std::vector<uint8_t> data = pattern(20);
+    ASSERT_TRUE(b.receive());
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+
+    RFM69HW::Packet packet;
+    ASSERT_TRUE(b.receive(packet));
+    ASSERT_EQ(data.size(), packet.size);
+    EXPECT_EQ(0, memcmp(data.data(), packet.data, packet.size));
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_STANDBY, simA.mode());
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_RX, simB.mode());
+}
+
+TEST_F(RFM69HWTest, AddressFilteringDropsOtherNodes) {
+    const std::vector<uint8_t> data = pattern(8);
+    a.setAddress(1);
+    b.setAddress(2);
+    ASSERT_TRUE(b.receive());
+
+    ASSERT_EQ(data.size(), a.sendTo(3, data.data(), data.size()));
+    EXPECT_EQ(0, b.available());
+
+    ASSERT_EQ(data.size(), a.sendTo(2, data.data(), data.size()));
+    RFM69HW::Packet packet;
+    ASSERT_TRUE(b.receive(packet));
+    EXPECT_EQ(2, packet.address);
+    EXPECT_EQ(data.size(), packet.size);
+}
+
+TEST_F(RFM69HWTest, AsyncPacketsGoOutBackToBack) {
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_TRUE(b.receive());
+    ASSERT_TRUE(a.sendAsync(data.data(), data.size()));
+    ASSERT_TRUE(a.sendAsync(data.data(), data.size()));
+    a.flush();
+
+    EXPECT_FALSE(a.transmitting());
+    EXPECT_EQ(2u, air.frames().size());
+
+    RFM69HW::Packet packet;
+    EXPECT_TRUE(b.receive(packet));
+    EXPECT_TRUE(b.receive(packet));
+}
+
+TEST_F(RFM69HWTest, InterruptHandlerDoesNotChangeModes) {
+    // Only IrqFlags2 is read on PacketSent. The next packet is loaded, and
+    // the mode restored, outside of interrupt context.
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_TRUE(a.receive());
+    simA.resetCounters();
+    ASSERT_TRUE(a.sendAsync(data.data(), data.size()));
+    ASSERT_TRUE(a.sendAsync(data.data(), data.size()));
+    a.flush();
+
+    EXPECT_EQ(2u, air.frames().size());
+    EXPECT_EQ(2u, simA.interrupts());
+    EXPECT_EQ(simA.interrupts(), simA.interruptTransactions());
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_RX, simA.mode());
+}
+
+TEST_F(RFM69HWTest, TransmitQueueMovesOnWhenPolled) {
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_TRUE(a.sendAsync(data.data(), data.size()));
+    ASSERT_TRUE(a.sendAsync(data.data(), data.size()));
+
+    for (int i = 0; i < 1000 && a.transmitting(); ++i)
+        air.advance(1000);
+    EXPECT_FALSE(a.transmitting());
+    EXPECT_EQ(2u, air.frames().size());
+}
+
+TEST_F(RFM69HWTest, AutoTransmitDoesNotEchoReceivedPackets) {
+    b.setAutoModes(RFM69HW::AutoEnterFifoNotEmpty, RFM69HW::AutoExitPacketSent, RFM69HW::AutoTransmit);
+    ASSERT_TRUE(b.receive());
+    EXPECT_EQ(RFM69HW_AUTOMODES_ENTER_OFF, simB.reg(RFM69HW_AUTOMODES) & RFM69HW_AUTOMODES_ENTER_MASK);
+
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+    air.advance(100000);
+    EXPECT_EQ(1u, air.frames().size());
+
+    RFM69HW::Packet packet;
+    ASSERT_TRUE(b.receive(packet));
+    EXPECT_EQ(data.size(), packet.size);
+
+    // Sending still keys up through AutoModes, and the receiver comes back
+    ASSERT_TRUE(a.receive());
+    ASSERT_EQ(data.size(), b.sendTo(0xFF, data.data(), data.size()));
+    EXPECT_EQ(2u, air.frames().size());
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_RX, simB.mode());
+    EXPECT_EQ(RFM69HW_AUTOMODES_ENTER_OFF, simB.reg(RFM69HW_AUTOMODES) & RFM69HW_AUTOMODES_ENTER_MASK);
+    EXPECT_TRUE(a.receive(packet));
+}
+
+TEST_F(RFM69HWTest, StreamWritesAreCollectedIntoOneFrame) {
+    const std::vector<uint8_t> data = pattern(10);
+    for (size_t i = 0; i < data.size(); ++i)
+        a.write(data[i]);
+    EXPECT_TRUE(air.frames().empty());
+
+    a.flush();
+    ASSERT_EQ(1u, air.frames().size());
+    EXPECT_EQ(1 + data.size(), air.frames()[0].bytes.size());
+}
+
+TEST_F(RFM69HWTest, AvailableQueuesIdleFrameWithoutWaiting) {
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_EQ(data.size(), a.write(data.data(), data.size()));
+    air.advance(20000);
+
+    // The frame is handed to the transmit queue, not sent while polling
+    const uint32_t start = air.now();
+    EXPECT_EQ(0, a.available());
+    EXPECT_LT(air.now() - start, a.airTime(data.size()) / 2);
+    EXPECT_TRUE(a.transmitting());
+
+    a.flush();
+    ASSERT_EQ(1u, air.frames().size());
+    EXPECT_EQ(1 + data.size(), air.frames()[0].bytes.size());
+}
+
+TEST_F(RFM69HWTest, LargeStreamWritesAreSplitIntoFrames) {
+    const std::vector<uint8_t> data = pattern(200);
+    ASSERT_TRUE(b.receive());
+    EXPECT_EQ(data.size(), a.write(data.data(), data.size()));
+    a.flush();
+
+    ASSERT_EQ(4u, air.frames().size());
+    std::vector<uint8_t> received;
+    for (size_t i = 0; i < air.frames().size(); ++i) {
+        const std::vector<uint8_t>& frame = air.frames()[i].bytes;
+        EXPECT_LE(frame.size(), 1u + RFM69HW_MAX_PAYLOAD);
+        received.insert(received.end(), frame.begin() + 1, frame.end());
+    }
+    EXPECT_EQ(data, received);
+
+    // Each frame can be taken by a receiver with the default settings
+    std::vector<uint8_t> read;
+    while (b.available())
+        read.push_back(b.read());
+    EXPECT_EQ(data, read);
+}
+
+TEST_F(RFM69HWTest, LongFrameIsStreamedThroughFifo) {
+    const std::vector<uint8_t> data = pattern(200);
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+
+    ASSERT_EQ(1u, air.frames().size());
+    const std::vector<uint8_t>& frame = air.frames()[0].bytes;
+    ASSERT_EQ(1 + data.size(), frame.size());
+    EXPECT_EQ(data.size(), frame[0]);
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), frame.begin() + 1));
+}
+
+TEST_F(RFM69HWTest, ReceiveStreamTakesLongFrame) {
+    std::vector<uint8_t> frame = pattern(201);
+    frame[0] = 200;
+    air.inject(simB.reg(RFM69HW_FRFMSB) << 16 | simB.reg(RFM69HW_FRFMID) << 8 | simB.reg(RFM69HW_FRFLSB),
+               frame, b.baudRate());
+
+    uint8_t buffer[255];
+    ASSERT_EQ(200u, b.receiveStream(buffer, sizeof(buffer), 100));
+    EXPECT_TRUE(std::equal(frame.begin() + 1, frame.end(), buffer));
+    EXPECT_EQ(RFM69HW_MAX_PAYLOAD, simB.reg(RFM69HW_PAYLOADLENGTH));
+}
+
+TEST_F(RFM69HWTest, UnlimitedFrameIgnoresAddressFilter) {
+    std::vector<uint8_t> data = pattern(300);
+    data[0] = 1;
+    a.setAddress(1);
+    b.setAddress(2);
+
+    // There is no address byte in unlimited length frames
+    ASSERT_EQ(data.size(), a.sendTo(2, data.data(), data.size()));
+    ASSERT_EQ(1u, air.frames().size());
+    const std::vector<uint8_t> frame = air.frames()[0].bytes;
+    ASSERT_EQ(data.size(), frame.size());
+
+    air.inject(simB.reg(RFM69HW_FRFMSB) << 16 | simB.reg(RFM69HW_FRFMID) << 8 | simB.reg(RFM69HW_FRFLSB),
+               frame, b.baudRate());
+
+    uint8_t buffer[300];
+    ASSERT_EQ(data.size(), b.receiveStream(buffer, sizeof(buffer), 100));
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), buffer));
+    EXPECT_EQ(RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_BOTH,
+              simB.reg(RFM69HW_PACKETCONFIG1) & RFM69HW_PACKETCONFIG1_ADDRESS_FILTERING_MASK);
+}
+
+TEST_F(RFM69HWTest, ReceivedPacketIsDrainedInTwoTransactions) {
+    const std::vector<uint8_t> data = pattern(30);
+    ASSERT_TRUE(b.receive());
+
+    simB.resetCounters();
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+
+    // IrqFlags2, then the whole FIFO in one burst
+    EXPECT_EQ(1u, simB.interrupts());
+    EXPECT_EQ(2u, simB.transactions());
+    EXPECT_EQ(2 + 1 + 1 + data.size(), simB.bytes());
+}
+
+TEST_F(RFM69HWTest, SendToCostDoesNotGrowWithPayload) {
+    // The FIFO is loaded in one burst, whatever fits in it
+    const std::vector<uint8_t> data = pattern(RFM69HW_MAX_PAYLOAD);
+    ASSERT_EQ(10u, a.sendTo(0xFF, data.data(), 10));
+
+    simA.resetCounters();
+    ASSERT_EQ(10u, a.sendTo(0xFF, data.data(), 10));
+    const uint32_t transactions = simA.transactions();
+    EXPECT_LE(transactions, 16u);
+
+    simA.resetCounters();
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+    EXPECT_EQ(transactions, simA.transactions());
+}
+
+TEST_F(RFM69HWTest, EveryHopInReceiveRestartsReceiver) {
+    const uint32_t frequencies[] = { 903000000, 905000000 };
+    uint32_t frf[2];
+    ASSERT_TRUE(b.setChannels(frequencies, frf, 2));
+    ASSERT_TRUE(b.receive());
+
+    simB.resetCounters();
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(b.hopNext());
+    EXPECT_EQ(4u, simB.restarts());
+    EXPECT_EQ(0, simB.reg(RFM69HW_PACKETCONFIG2) & RFM69HW_PACKETCONFIG2_RESTART_RX);
+}
+
+TEST_F(RFM69HWTest, ChannelTableCanBeSetAgain) {
+    const uint32_t frequencies[] = { 903000000, 915000000 };
+    uint32_t frf[2];
+    ASSERT_TRUE(a.setChannels(frequencies, frf, 2));
+    ASSERT_TRUE(a.setChannels(frequencies, frf, 2));
+    EXPECT_EQ(903000000u, frequencies[0]);
+
+    ASSERT_TRUE(a.hopTo(1));
+    EXPECT_EQ(915000000u, a.carrierFrequency());
+}
+
+TEST_F(RFM69HWTest, HopSequenceVisitsEveryChannelOutOfOrder) {
+    uint32_t frequencies[50];
+    for (int i = 0; i < 50; ++i)
+        frequencies[i] = 902200000 + i * 200000;
+    uint32_t frf[50];
+
+    std::vector<int> first;
+    for (uint8_t seed = 0; seed < 2; ++seed) {
+        ASSERT_TRUE(a.setChannels(frequencies, frf, 50, seed));
+
+        std::vector<int> order;
+        for (int i = 0; i < 50; ++i) {
+            ASSERT_TRUE(a.hopNext());
+            order.push_back(a.channel());
+        }
+
+        // One full cycle covers the table, and is not just a walk along it
+        std::vector<int> sorted = order;
+        std::sort(sorted.begin(), sorted.end());
+        for (int i = 0; i < 50; ++i)
+            EXPECT_EQ(i, sorted[i]);
+
+        int steps = 0;
+        for (int i = 1; i < 50; ++i)
+            steps += order[i] == order[i - 1] + 1;
+        EXPECT_LT(steps, 5);
+
+        if (seed == 0)
+            first = order;
+        else
+            EXPECT_NE(first, order);
+    }
+}
+
+TEST_F(RFM69HWTest, ListenBeforeTalkLeavesReceiverThresholdAlone) {
+    const uint8_t threshold = simA.reg(RFM69HW_RSSITHRESH);
+    ASSERT_TRUE(a.setListenBeforeTalk(-80, 20));
+    EXPECT_EQ(threshold, simA.reg(RFM69HW_RSSITHRESH));
+    ASSERT_TRUE(a.receive());
+
+    const std::vector<uint8_t> data = pattern(10);
+    simA.setRssi(-70);
+    EXPECT_FALSE(a.channelClear());
+    EXPECT_EQ(0u, a.sendTo(0xFF, data.data(), data.size()));
+    EXPECT_TRUE(air.frames().empty());
+
+    simA.setRssi(-100);
+    EXPECT_TRUE(a.channelClear());
+    EXPECT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+
+    a.disableListenBeforeTalk();
+    EXPECT_EQ(threshold, simA.reg(RFM69HW_RSSITHRESH));
+}
+
+TEST_F(RFM69HWTest, ContinuousModeRefusesPackets) {
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_TRUE(a.setDataMode(RFM69HW::Continuous));
+    EXPECT_EQ(0u, a.sendBurst(data.data(), data.size(), 10));
+    EXPECT_FALSE(a.sendAsync(data.data(), data.size()));
+    EXPECT_EQ(0u, a.sendTo(0xFF, data.data(), data.size()));
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_STANDBY, simA.mode());
+    EXPECT_TRUE(air.frames().empty());
+
+    const uint8_t dataModul = simA.reg(RFM69HW_DATAMODUL);
+    EXPECT_FALSE(a.setDataMode(static_cast<RFM69HW::DataMode>(3)));
+    EXPECT_EQ(dataModul, simA.reg(RFM69HW_DATAMODUL));
+
+    ASSERT_TRUE(a.setDataMode(RFM69HW::PacketMode));
+    EXPECT_EQ(data.size(), a.sendBurst(data.data(), data.size(), 10));
+}
+
+TEST_F(RFM69HWTest, TunedReceiverKeepsLearnedOffset) {
+    const std::vector<uint8_t> data = pattern(8);
+    const int32_t offset = a.frequencyOffset(2);
+    a.setAddress(1);
+    b.setAddress(2);
+    b.setDriftTracking(true);
+    simA.setFrequencyError(300);
+    ASSERT_TRUE(b.receive());
+
+    RFM69HW::Packet packet;
+    ASSERT_EQ(data.size(), a.sendTo(2, data.data(), data.size()));
+    ASSERT_TRUE(b.receive(packet));
+    const int32_t learned = b.frequencyOffset(2);
+    EXPECT_NE(offset, learned);
+
+    // Centred on the sender, the AFC reads close to zero from now on
+    ASSERT_TRUE(b.tuneTo(2));
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQ(data.size(), a.sendTo(2, data.data(), data.size()));
+        ASSERT_TRUE(b.receive(packet));
+    }
+    EXPECT_EQ(learned, b.frequencyOffset(2));
+}
+
+TEST_F(RFM69HWTest, TemperatureKeepsReceiverRunning) {
+    simA.setTemperature(25);
+    ASSERT_TRUE(a.receive());
+    EXPECT_EQ(25, a.temperature());
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_RX, simA.reg(RFM69HW_OPMODE) & RFM69HW_OPMODE_MODE_MASK);
+}
+
+TEST_F(RFM69HWTest, PeerTableForgetsLeastRecentlyHeardPeer) {
+    RFM69HWPower power(a);
+    power.acknowledged(1, -40);
+    const int8_t lowered = power.power(1);
+    ASSERT_GT(20, lowered);
+
+    // Peer 1 is heard from again once the table is full, so peer 2 goes
+    for (uint8_t address = 2; address <= RFM69HW_POWER_PEERS; ++address)
+        power.power(address);
+    EXPECT_EQ(lowered, power.power(1));
+    power.power(100);
+    EXPECT_EQ(lowered, power.power(1));
+
+    // Peer 1 goes once it is the oldest
+    for (uint8_t address = 200; address < 200 + RFM69HW_POWER_PEERS; ++address)
+        power.power(address);
+    EXPECT_EQ(20, power.power(1));
+}
+
+TEST_F(RFM69HWTest, SnifferCapturesBadFrameAfterTransmit) {
+    // Collects the records written by sniff()
+    struct Records : public Print {
+        size_t write(uint8_t value) {
+            bytes.push_back(value);
+            return 1;
+        }
+
+        std::vector<uint8_t> bytes;
+    };
+
+    const std::vector<uint8_t> data = pattern(8);
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+    ASSERT_TRUE(a.setSniffing(true));
+
+    air.corruptNext();
+    ASSERT_EQ(data.size(), b.sendTo(0xFF, data.data(), data.size()));
+
+    // Sync byte, header, frame and check byte, with the CRC status cleared
+    Records records;
+    ASSERT_TRUE(a.sniff(records));
+    ASSERT_LE(11u, records.bytes.size());
+    EXPECT_EQ(11u + records.bytes[1] + 1u, records.bytes.size());
+    EXPECT_EQ(0, records.bytes[9]);
+}
+
+// Services a gateway and a node for the given time, or until done() says so
+template<typename Done>
+bool runCell(RFM69HWAir& air, RFM69HWTdma* gateway, RFM69HWTdma& node, const uint32_t time, Done done) {
+    const uint32_t start = air.now();
+    while (air.now() - start < time) {
+        if (gateway)
+            gateway->service();
+        node.service();
+        if (done())
+            return true;
+        air.advance(100);
+    }
+    return false;
+}
+
+bool isBeacon(const RFM69HWAir::Frame& frame) {
+    return frame.bytes.size() == 6 && frame.bytes[2] == 0xBE;
+}
+
+TEST_F(RFM69HWTest, TdmaNodeSendsInItsSlot) {
+    const std::vector<uint8_t> data = pattern(16);
+    a.setAddress(1, 0xAA);
+    b.setAddress(2, 0xAA);
+
+    RFM69HWTdma gateway(a);
+    RFM69HWTdma node(b);
+    ASSERT_TRUE(gateway.beginGateway(2, data.size()));
+    ASSERT_TRUE(node.beginNode(1, 1));
+
+    // Beacons go to the cell's broadcast address. The slot is only used once
+    // the node has measured the frame length over a few beacons.
+    ASSERT_TRUE(runCell(air, &gateway, node, 2000000, [&]() { return node.synchronized(); }));
+    runCell(air, &gateway, node, 500000, []() { return false; });
+    ASSERT_TRUE(node.send(data.data(), data.size()));
+
+    RFM69HW::Packet packet;
+    ASSERT_TRUE(runCell(air, &gateway, node, 2000000, [&]() { return a.receive(packet); }));
+    EXPECT_EQ(data.size(), packet.size);
+    EXPECT_FALSE(node.pending());
+
+    // Slot 1 is the last of the three parts of a frame, after the beacon and
+    // slot 0. The packet goes out in the second half of the frame, and is
+    // over before the next beacon.
+    const std::vector<RFM69HWAir::Frame>& frames = air.frames();
+    ASSERT_LE(3u, frames.size());
+    const RFM69HWAir::Frame& sent = frames.back();
+    ASSERT_FALSE(isBeacon(sent));
+    ASSERT_TRUE(isBeacon(frames[frames.size() - 2]));
+    ASSERT_TRUE(isBeacon(frames[frames.size() - 3]));
+    const uint32_t period = frames[frames.size() - 2].start - frames[frames.size() - 3].start;
+    const uint32_t offset = sent.start - frames[frames.size() - 2].start;
+    EXPECT_GE(offset, period / 2);
+    EXPECT_LT(offset + a.airTime(data.size()), period);
+}
+
+TEST_F(RFM69HWTest, TdmaNodeSyncsAgainAfterMissedBeacons) {
+    RFM69HWTdma gateway(a);
+    RFM69HWTdma node(b);
+    ASSERT_TRUE(gateway.beginGateway(2, 16));
+    ASSERT_TRUE(node.beginNode(0, 1));
+    ASSERT_TRUE(runCell(air, &gateway, node, 2000000, [&]() { return node.synchronized(); }));
+
+    // The gateway goes quiet for longer than a node may go without a beacon
+    EXPECT_TRUE(runCell(air, NULL, node, 5000000, [&]() { return !node.synchronized(); }));
+
+    ASSERT_TRUE(runCell(air, &gateway, node, 2000000, [&]() { return node.synchronized(); }));
+}
+
+TEST_F(RFM69HWTest, SetModemChangesBitRate) {
+    const uint32_t bitrate = RFM69HW_CONFIG_FXOSC_HZ / 38400;
+    ASSERT_TRUE(a.setModem(RFM69HW::Modem38400));
+    EXPECT_EQ(bitrate, (uint32_t)(simA.reg(RFM69HW_BITRATEMSB) << 8 | simA.reg(RFM69HW_BITRATELSB)));
+    EXPECT_EQ(RFM69HW_CONFIG_FXOSC_HZ / bitrate, a.baudRate());
+
+    EXPECT_FALSE(a.setModem(RFM69HW::ModemCount));
+    EXPECT_EQ(RFM69HW_CONFIG_FXOSC_HZ / bitrate, a.baudRate());
+}
+
+TEST_F(RFM69HWTest, RateStepsUpAfterSuccesses) {
+    RFM69HWRate rate(a);
+    for (int i = 0; i < 7; ++i)
+        rate.success(1, -40);
+    EXPECT_EQ(RFM69HW::Modem4800, rate.modem(1));
+    rate.success(1, -40);
+    EXPECT_EQ(RFM69HW::Modem9600, rate.modem(1));
+
+    // Failed RSSI readings say nothing about the link
+    for (int i = 0; i < 8; ++i)
+        rate.success(1, RFM69HW_READING_FAILED);
+    EXPECT_EQ(RFM69HW::Modem9600, rate.modem(1));
+
+    ASSERT_TRUE(rate.select(1));
+    EXPECT_EQ(RFM69HW_CONFIG_FXOSC_HZ / (RFM69HW_CONFIG_FXOSC_HZ / 9600), a.baudRate());
+}
+
+TEST_F(RFM69HWTest, RateStepsDownAfterFailures) {
+    RFM69HWRate rate(a);
+    for (int i = 0; i < 8; ++i)
+        rate.success(1, -40);
+    ASSERT_EQ(RFM69HW::Modem9600, rate.modem(1));
+
+    rate.failure(1);
+    EXPECT_EQ(RFM69HW::Modem9600, rate.modem(1));
+    rate.failure(1);
+    EXPECT_EQ(RFM69HW::Modem4800, rate.modem(1));
+
+    // Never below the slowest profile
+    for (int i = 0; i < 8; ++i)
+        rate.failure(1);
+    EXPECT_EQ(RFM69HW::Modem4800, rate.modem(1));
+}
+
+TEST_F(RFM69HWTest, HandlesOutsideThePoolAreRefused) {
+    EXPECT_EQ(0, a.packet(RFM69HW_NO_PACKET).size);
+    EXPECT_EQ(0u, a.receiveTime(RFM69HW_NO_PACKET));
+    EXPECT_FALSE(a.sendAsync(RFM69HW_NO_PACKET));
+
+    // A buffer which was given back can no longer be sent
+    const RFM69HW::Handle handle = a.allocate();
+    ASSERT_NE(RFM69HW_NO_PACKET, handle);
+    a.packet(handle).size = 4;
+    a.release(handle);
+    EXPECT_FALSE(a.sendAsync(handle));
+    EXPECT_FALSE(a.transmitting());
+    EXPECT_TRUE(air.frames().empty());
+}
+
+TEST(RFM69HWConfigTest, ConfigIsAppliedAndReadBack) {
+    typedef RFM69HW::Config<
+        RFM69HW::Bitrate<38400>,
+        RFM69HW::Fdev<40000>,
+        RFM69HW::Frequency<868000000>
+    > RadioConfig;
+
+    RFM69HWAir air;
+    RFM69HWSimulator simA(air);
+    RFM69HWSimulator simB(air);
+    RFM69HW a(2, SS, -1, simA);
+    RFM69HW b(3, SS, -1, simB);
+    ASSERT_TRUE(a.begin<RadioConfig>());
+    ASSERT_TRUE(b.begin());
+    b.configure<RadioConfig>();
+
+    EXPECT_EQ(868000000u, a.carrierFrequency());
+    EXPECT_EQ(38400u, a.baudRate());
+    EXPECT_EQ(RFM69HW_CONFIG_FXOSC_HZ / 38400, (uint32_t)(simA.reg(RFM69HW_BITRATEMSB) << 8 | simA.reg(RFM69HW_BITRATELSB)));
+
+    // Tuning to a peer with no known offset goes back to the configured
+    // carrier, not the one from before the configuration
+    ASSERT_TRUE(a.tuneTo(1));
+    EXPECT_EQ(868000000u, a.carrierFrequency());
+
+    const std::vector<uint8_t> data = pattern(12);
+    ASSERT_TRUE(b.receive());
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+    RFM69HW::Packet packet;
+    ASSERT_TRUE(b.receive(packet));
+    EXPECT_EQ(data.size(), packet.size);
+    EXPECT_EQ(868000000u, air.frames()[0].frf * 15625ULL / 256);
+}
+
+TEST_F(RFM69HWTest, ListeningReceiverPicksUpBurst) {
+    ASSERT_TRUE(b.listen(50000, 2000));
+    EXPECT_TRUE(simB.reg(RFM69HW_OPMODE) & RFM69HW_OPMODE_LISTEN_ON);
+    EXPECT_EQ(RFM69HW_LISTEN1_RESOL_IDLE_4_1MS | RFM69HW_LISTEN1_RESOL_RX_64US | RFM69HW_LISTEN1_CRITERIA_SYNC |
+              RFM69HW_LISTEN1_END_RESUME, simB.reg(RFM69HW_LISTEN1));
+    EXPECT_EQ(13, simB.reg(RFM69HW_LISTEN2));
+    EXPECT_EQ(32, simB.reg(RFM69HW_LISTEN3));
+
+    // The burst repeats the packet for the whole duration
+    const std::vector<uint8_t> data = pattern(8);
+    ASSERT_EQ(data.size(), a.sendBurst(data.data(), data.size(), 60));
+    EXPECT_LT(1u, air.frames().size());
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_STANDBY, simA.mode());
+
+    RFM69HW::Packet packet;
+    ASSERT_TRUE(b.receive(packet));
+    EXPECT_EQ(data.size(), packet.size);
+    EXPECT_EQ(0, memcmp(data.data(), packet.data, packet.size));
+
+    // Still listening until told otherwise
+    EXPECT_TRUE(simB.reg(RFM69HW_OPMODE) & RFM69HW_OPMODE_LISTEN_ON);
+    ASSERT_TRUE(b.standby());
+    EXPECT_FALSE(simB.reg(RFM69HW_OPMODE) & RFM69HW_OPMODE_LISTEN_ON);
+}
+
+TEST_F(RFM69HWTest, EncryptionKeyIsWrittenFromStandby) {
+    uint8_t key[RFM69HW_AES_KEY_SIZE];
+    for (uint8_t i = 0; i < sizeof(key); ++i)
+        key[i] = 0xA0 + i;
+
+    // The device only takes the key outside of RX
+    ASSERT_TRUE(b.receive());
+    b.setEncryptionKey(key);
+    for (uint8_t i = 0; i < sizeof(key); ++i)
+        EXPECT_EQ(key[i], simB.reg(RFM69HW_AESKEY1 + i));
+    EXPECT_TRUE(simB.reg(RFM69HW_PACKETCONFIG2) & RFM69HW_PACKETCONFIG2_AES_ON);
+    EXPECT_EQ(RFM69HW_OPMODE_MODE_RX, simB.mode());
+
+    b.disableEncryption();
+    EXPECT_FALSE(simB.reg(RFM69HW_PACKETCONFIG2) & RFM69HW_PACKETCONFIG2_AES_ON);
+}
+
+TEST_F(RFM69HWTest, EncryptedPayloadsFitTheAesEngine) {
+    uint8_t key[RFM69HW_AES_KEY_SIZE] = {};
+    const std::vector<uint8_t> data = pattern(100);
+    a.setAddress(1);
+    a.setEncryptionKey(key);
+    const size_t limit = RFM69HW_MAX_AES_PAYLOAD - 1;
+
+    // Blocking sends are cut short
+    ASSERT_EQ(limit, a.sendTo(2, data.data(), data.size()));
+    ASSERT_EQ(1u, air.frames().size());
+    EXPECT_EQ(2 + limit, air.frames()[0].bytes.size());
+
+    // Queued packets which do not fit are refused
+    EXPECT_FALSE(a.sendAsync(data.data(), limit + 1));
+    EXPECT_TRUE(a.sendAsync(data.data(), limit));
+    a.flush();
+    ASSERT_EQ(2u, air.frames().size());
+    EXPECT_EQ(2 + limit, air.frames()[1].bytes.size());
+
+    // Stream writes are split into frames which fit
+    air.clearFrames();
+    EXPECT_EQ(data.size(), a.write(data.data(), data.size()));
+    a.flush();
+    ASSERT_EQ(2u, air.frames().size());
+    EXPECT_EQ(2 + limit, air.frames()[0].bytes.size());
+    EXPECT_EQ(2 + data.size() - limit, air.frames()[1].bytes.size());
+}
+
+#if RFM69HW_INSTRUMENTATION
+TEST_F(RFM69HWTest, ProfilesCountBusTrafficPerCall) {
+    a.resetProfiles();
+    simA.resetCounters();
+    ASSERT_TRUE(a.setTransmitPower(10));
+
+    const RFM69HW::Profile& configuration = a.profile(RFM69HW::ProfileConfiguration);
+    EXPECT_EQ(1u, configuration.calls);
+    EXPECT_LT(0u, configuration.transactions);
+    EXPECT_EQ(simA.transactions(), configuration.transactions);
+    EXPECT_EQ(simA.bytes(), configuration.bytes);
+    EXPECT_EQ(0u, a.profile(RFM69HW::ProfileWrite).calls);
+
+    // Traffic from the interrupt handler is charged to it alone
+    b.resetProfiles();
+    simB.resetCounters();
+    ASSERT_TRUE(b.receive());
+    const uint32_t before = b.profile(RFM69HW::ProfileOpMode).transactions;
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+    EXPECT_EQ(before, b.profile(RFM69HW::ProfileOpMode).transactions);
+    EXPECT_EQ(1u, b.profile(RFM69HW::ProfileInterrupt).calls);
+    EXPECT_EQ(simB.interruptTransactions(), b.profile(RFM69HW::ProfileInterrupt).transactions);
+}
+
+TEST_F(RFM69HWTest, WaitsRecordTheirWorstCase) {
+    a.resetProfiles();
+    EXPECT_EQ(0u, a.worstWait(RFM69HW::WaitPacketSent));
+
+    const std::vector<uint8_t> data = pattern(10);
+    ASSERT_EQ(data.size(), a.sendTo(0xFF, data.data(), data.size()));
+    const uint32_t worst = a.worstWait(RFM69HW::WaitPacketSent);
+    EXPECT_GE(worst, a.airTime(data.size()) / 2);
+    EXPECT_LE(worst, a.airTime(data.size()) * 2);
+
+    // A shorter packet leaves the worst case alone
+    ASSERT_EQ(1u, a.sendTo(0xFF, data.data(), 1));
+    EXPECT_EQ(worst, a.worstWait(RFM69HW::WaitPacketSent));
+
+    a.resetProfiles();
+    EXPECT_EQ(0u, a.worstWait(RFM69HW::WaitPacketSent));
+}
+#endif
+
+TEST_F(RFM69HWTest, DeadDeviceTimesOut) {
+    simA.setResponding(false);
+
+    const uint32_t start = air.now();
+    EXPECT_FALSE(a.standby());
+    EXPECT_GE(air.now() - start, 10000u);
+    EXPECT_LT(air.now() - start, 20000u);
+}
+
+TEST_F(RFM69HWTest, DeadDeviceTimesOutWhileSending) {
+    const std::vector<uint8_t> data = pattern(5);
+    simA.setResponding(false);
+
+    // Timeouts come from the bit rate, which can no longer be read back
+    const uint32_t start = air.now();
+    a.sendAsync(data.data(), data.size());
+    a.flush();
+    EXPECT_FALSE(a.transmitting());
+    EXPECT_LT(air.now() - start, 1000000u);
+}
+
+TEST_F(RFM69HWTest, GroupedRadiosReceiveWithInterruptTime) {
+    RFM69HWSimulator simC(air);
+    RFM69HW c(4, SS, -1, simC);
+    ASSERT_TRUE(c.begin());
+
+    RFM69HWGroup group;
+    ASSERT_TRUE(group.add(a));
+    ASSERT_TRUE(group.add(b));
+    EXPECT_FALSE(group.add(a));
+    ASSERT_TRUE(a.receive());
+    ASSERT_TRUE(b.receive());
+
+    const std::vector<uint8_t> data = pattern(12);
+    simA.resetCounters();
+    ASSERT_EQ(data.size(), c.sendTo(0xFF, data.data(), data.size()));
+    const uint32_t sent = air.now();
+
+    // Nothing is read from the grouped radios until the group is serviced,
+    // however long the main loop takes to get there
+    air.advance(50000);
+    EXPECT_EQ(0u, simA.interruptTransactions());
+    EXPECT_EQ(2u, group.service());
+
+    RFM69HW* radios[] = { &a, &b };
+    for (size_t i = 0; i < 2; ++i) {
+        const RFM69HW::Handle handle = radios[i]->borrow();
+        ASSERT_NE(RFM69HW_NO_PACKET, handle);
+        EXPECT_EQ(data.size(), radios[i]->packet(handle).size);
+        EXPECT_GT(radios[i]->receiveTime(handle), air.frames()[0].start);
+        EXPECT_LE(radios[i]->receiveTime(handle), sent);
+        radios[i]->release(handle);
+    }
+}
+
+} // namespace